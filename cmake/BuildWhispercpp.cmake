@@ -10,11 +10,44 @@ else()
   set(Whispercpp_BUILD_TYPE Debug)
 endif()
 
+set(LINUX_BLAS_VENDOR
+    OFF
+    CACHE STRING "CPU BLAS library for the whisper.cpp encoder on Linux: OFF, OpenBLAS or BLIS")
+
 if(UNIX AND NOT APPLE)
   # On linux add the `-fPIC` flag to the compiler
   set(WHISPER_EXTRA_CXX_FLAGS "-fPIC")
-  set(WHISPER_ADDITIONAL_CMAKE_ARGS -DWHISPER_BLAS=OFF -DWHISPER_CUBLAS=OFF -DWHISPER_OPENBLAS=OFF -DWHISPER_NO_AVX=ON
-                                    -DWHISPER_NO_AVX2=ON)
+  if(LINUX_BLAS_VENDOR)
+    # Link a system BLAS, or a bundled one found through BLAS_ROOT / CMAKE_PREFIX_PATH
+    if(LINUX_BLAS_VENDOR STREQUAL "BLIS")
+      # FindBLAS calls BLIS by its FLAME project name
+      set(Whispercpp_BLAS_VENDOR FLAME)
+    elseif(LINUX_BLAS_VENDOR STREQUAL "OpenBLAS")
+      set(Whispercpp_BLAS_VENDOR OpenBLAS)
+    else()
+      message(FATAL_ERROR "Unsupported LINUX_BLAS_VENDOR ${LINUX_BLAS_VENDOR}, use OFF, OpenBLAS or BLIS")
+    endif()
+    set(BLA_VENDOR ${Whispercpp_BLAS_VENDOR})
+    find_package(BLAS REQUIRED)
+    find_path(
+      Whispercpp_CBLAS_INCLUDE_DIR cblas.h
+      HINTS ${BLAS_ROOT} $ENV{BLAS_ROOT}
+      PATH_SUFFIXES include include/openblas include/blis openblas blis)
+    if(NOT Whispercpp_CBLAS_INCLUDE_DIR)
+      message(FATAL_ERROR "cblas.h of ${LINUX_BLAS_VENDOR} not found, set Whispercpp_CBLAS_INCLUDE_DIR")
+    endif()
+    message(STATUS "Building whisper.cpp with ${LINUX_BLAS_VENDOR}: ${BLAS_LIBRARIES}, "
+                   "${Whispercpp_CBLAS_INCLUDE_DIR}/cblas.h")
+    # whisper.cpp is built without its own BLAS detection, which could resolve another library
+    # than the one above: ggml is compiled against the header found here and the static library
+    # gets the resolved BLAS_LIBRARIES at plugin link time
+    string(APPEND WHISPER_EXTRA_CXX_FLAGS " -DGGML_USE_OPENBLAS -I${Whispercpp_CBLAS_INCLUDE_DIR}")
+    set(WHISPER_ADDITIONAL_CMAKE_ARGS -DWHISPER_BLAS=OFF -DWHISPER_CUBLAS=OFF -DWHISPER_OPENBLAS=OFF -DWHISPER_NO_AVX=ON
+                                      -DWHISPER_NO_AVX2=ON)
+  else()
+    set(WHISPER_ADDITIONAL_CMAKE_ARGS -DWHISPER_BLAS=OFF -DWHISPER_CUBLAS=OFF -DWHISPER_OPENBLAS=OFF -DWHISPER_NO_AVX=ON
+                                      -DWHISPER_NO_AVX2=ON)
+  endif()
 endif()
 if(APPLE)
   # check the "MACOS_ARCH" env var to figure out if this is x86 or arm64
@@ -162,6 +195,12 @@ target_link_libraries(Whispercpp INTERFACE Whispercpp::Whisper)
 if(WIN32 AND NOT LOCALVOCAL_WITH_CUDA)
   target_link_libraries(Whispercpp INTERFACE Whispercpp::OpenBLAS)
 endif()
+if(UNIX
+   AND NOT APPLE
+   AND LINUX_BLAS_VENDOR)
+  # the static whisper library needs the BLAS symbols at plugin link time
+  target_link_libraries(Whispercpp INTERFACE ${BLAS_LIBRARIES} ${BLAS_LINKER_FLAGS})
+endif()
 set_target_properties(Whispercpp::Whisper PROPERTIES INTERFACE_INCLUDE_DIRECTORIES ${INSTALL_DIR}/include)
 if(APPLE)
   target_link_libraries(Whispercpp INTERFACE "-framework Accelerate")
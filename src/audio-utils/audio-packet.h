@@ -0,0 +1,14 @@
+#ifndef AUDIO_PACKET_H
+#define AUDIO_PACKET_H
+
+#include <cstdint>
+
+// Audio packet info, queued next to the planar audio of the packets
+struct cleanstream_audio_info {
+	uint32_t frames;
+	uint64_t timestamp;
+	// frames of the original audio the packet covers, fewer frames when it was shortened
+	uint32_t source_frames;
+};
+
+#endif // AUDIO_PACKET_H
@@ -0,0 +1,209 @@
+#include "delay-line.h"
+#include "time-stretch.h"
+
+#include <util/platform.h>
+
+#include <algorithm>
+#include <cmath>
+
+// catch-up drains the latency above the target over about this long, at 3% at least
+#define CATCHUP_DRAIN_SEC 10.0
+#define CATCHUP_MIN_SPEEDUP 0.03
+// with this much latency above the target the delay line is dropped instead
+#define CATCHUP_RESET_NS 10000000000ULL
+// crossfade around cut fillers
+#define CUT_FADE_MSEC 10
+#define CUT_WINDOW_NS 60000000000ULL
+// a cut has to leave audio to play for this much longer than the next segment takes
+#define CUT_MARGIN_MSEC 100
+// the latency taken off by cuts is given back in pauses peaking below this (-50 dBFS)
+#define CUT_RECOVER_PEAK 0.003f
+
+uint64_t delay_line_target_ns(const delay_line &line)
+{
+	const uint64_t target_ns = line.target_ns;
+	const uint64_t cut_ns = line.cut_latency_ns;
+	return target_ns > cut_ns ? target_ns - cut_ns : 0;
+}
+
+double delay_line_catchup_speed(const delay_line &line, uint64_t added_latency_ns,
+				size_t frames, uint32_t sample_rate)
+{
+	if (!line.catchup_enabled) {
+		return 1.0;
+	}
+	const double excess_sec =
+		((double)added_latency_ns - (double)delay_line_target_ns(line)) / 1e9;
+	if (excess_sec <= 0.0) {
+		return 1.0;
+	}
+	double speedup = std::clamp(excess_sec / CATCHUP_DRAIN_SEC, CATCHUP_MIN_SPEEDUP,
+				    (double)line.max_speedup);
+	// never drop more than the excess
+	const double segment_sec = (double)frames / sample_rate;
+	if (segment_sec > excess_sec) {
+		speedup = std::min(speedup, excess_sec / (segment_sec - excess_sec));
+	}
+	return speedup < 0.005 ? 1.0 : 1.0 + speedup;
+}
+
+size_t delay_line_shorten(delay_line &line, float **segment, size_t channels, size_t frames,
+			  double speed, uint32_t sample_rate)
+{
+	const size_t out_frames =
+		time_compress(segment, channels, frames, speed, sample_rate, line.stretch_buffers);
+	for (size_t c = 0; c < channels; c++) {
+		segment[c] = line.stretch_buffers[c].data();
+	}
+	return out_frames;
+}
+
+bool delay_line_try_cut(delay_line &line, uint64_t frames, size_t queued_frames,
+			size_t hop_frames, int64_t processing_ms, uint32_t sample_rate)
+{
+	const uint64_t now = os_gettime_ns();
+	while (!line.cut_history.empty() && now - line.cut_history.front().first > CUT_WINDOW_NS) {
+		line.cut_frames_last_min -= line.cut_history.front().second;
+		line.cut_history.pop_front();
+	}
+	if (line.cut_frames_last_min + frames > line.cut_max_frames_per_min) {
+		return false;
+	}
+	const size_t needed_frames =
+		hop_frames +
+		(size_t)(processing_ms + CUT_MARGIN_MSEC + CUT_FADE_MSEC) * sample_rate / 1000;
+	if (queued_frames < needed_frames) {
+		return false;
+	}
+	line.cut_history.emplace_back(now, frames);
+	line.cut_frames_last_min += frames;
+	return true;
+}
+
+void delay_line_queue_cut(delay_line &line, uint64_t frames, uint32_t sample_rate)
+{
+	line.cut_fade_pending = true;
+	line.cut_latency_ns += frames * 1000000000ULL / sample_rate;
+}
+
+size_t delay_line_crossfade_cut(delay_line &line, struct circlebuf *queues, size_t channels,
+				float *const *segment, size_t frames, uint32_t sample_rate)
+{
+	if (!line.cut_fade_pending || frames == 0) {
+		return 0;
+	}
+	line.cut_fade_pending = false;
+	const size_t fade_frames = std::min((size_t)(CUT_FADE_MSEC * sample_rate / 1000), frames);
+	const size_t tail_frames = std::min(fade_frames, queues[0].size / sizeof(float));
+	if (tail_frames == 0) {
+		// the output ran dry, fade in from the silence instead
+		for (size_t c = 0; c < channels; c++) {
+			for (size_t i = 0; i < fade_frames; i++) {
+				segment[c][i] *= (float)(i + 1) / (float)(fade_frames + 1);
+			}
+		}
+		return 0;
+	}
+	line.cut_fade_buffer.resize(tail_frames);
+	float *tail = line.cut_fade_buffer.data();
+	for (size_t c = 0; c < channels; c++) {
+		circlebuf_pop_back(&queues[c], tail, tail_frames * sizeof(float));
+		for (size_t i = 0; i < tail_frames; i++) {
+			const float gain = (float)(i + 1) / (float)(tail_frames + 1);
+			tail[i] = tail[i] * (1.0f - gain) + segment[c][i] * gain;
+		}
+		circlebuf_push_back(&queues[c], tail, tail_frames * sizeof(float));
+	}
+	// the overlap shortens the audio as much as a cut
+	line.cut_latency_ns += (uint64_t)tail_frames * 1000000000ULL / sample_rate;
+	return tail_frames;
+}
+
+// Capture time of the frame after the ones played from the current packet
+static uint64_t packet_content_ts(const delay_line &line, uint32_t sample_rate)
+{
+	const struct cleanstream_audio_info &packet = line.packet;
+	const uint64_t played_source_frames =
+		(uint64_t)(packet.frames - line.packet_left) * packet.source_frames / packet.frames;
+	return packet.timestamp + played_source_frames * 1000000000ULL / sample_rate;
+}
+
+// Whether the next frames of the queue are a pause, where held output is not heard. The
+// frames are peeked into out.
+static bool pause_ahead(struct circlebuf *queues, size_t channels, uint32_t frames,
+			uint8_t **out)
+{
+	if (queues[0].size < frames * sizeof(float)) {
+		return false;
+	}
+	for (size_t c = 0; c < channels; c++) {
+		float *samples = (float *)out[c];
+		circlebuf_peek_front(&queues[c], samples, frames * sizeof(float));
+		for (uint32_t i = 0; i < frames; i++) {
+			if (fabsf(samples[i]) >= CUT_RECOVER_PEAK) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+delay_line_playback delay_line_play(delay_line &line, struct circlebuf *info_queue,
+				    struct circlebuf *queues, size_t channels,
+				    uint32_t sample_rate, uint64_t input_end_ts, uint32_t frames,
+				    uint8_t **out)
+{
+	delay_line_playback playback;
+
+	if (!line.primed && info_queue->size > 0) {
+		struct cleanstream_audio_info head;
+		circlebuf_peek_front(info_queue, &head, sizeof(head));
+		if (input_end_ts >= head.timestamp + line.target_ns) {
+			line.primed = true;
+			line.content_ts = head.timestamp;
+		}
+	}
+
+	const uint64_t cut_ns = line.cut_latency_ns;
+	if (line.primed && cut_ns > 0 && pause_ahead(queues, channels, frames, out)) {
+		// play silence instead of the pause, the latency grows by the packet
+		const uint64_t packet_ns = (uint64_t)frames * 1000000000ULL / sample_rate;
+		line.cut_latency_ns = cut_ns > packet_ns ? cut_ns - packet_ns : 0;
+		playback.held = true;
+	}
+
+	while (line.primed && !playback.held && playback.filled < frames) {
+		if (line.packet_left == 0) {
+			if (info_queue->size == 0) {
+				break;
+			}
+			circlebuf_pop_front(info_queue, &line.packet, sizeof(line.packet));
+			line.packet_left = line.packet.frames;
+		}
+		const uint32_t n = std::min(frames - playback.filled, line.packet_left);
+		for (size_t c = 0; c < channels; c++) {
+			circlebuf_pop_front(&queues[c], out[c] + playback.filled * sizeof(float),
+					    n * sizeof(float));
+		}
+		line.packet_left -= n;
+		playback.filled += n;
+		line.content_ts = packet_content_ts(line, sample_rate);
+	}
+
+	if (line.primed) {
+		playback.primed = true;
+		playback.latency_ns =
+			input_end_ts > line.content_ts ? input_end_ts - line.content_ts : 0;
+		playback.reset =
+			playback.latency_ns > delay_line_target_ns(line) + CATCHUP_RESET_NS;
+	}
+	return playback;
+}
+
+void delay_line_reset(delay_line &line)
+{
+	line.primed = false;
+	line.packet_left = 0;
+	line.cut_latency_ns = 0;
+	line.cut_fade_pending = false;
+}
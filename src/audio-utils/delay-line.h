@@ -0,0 +1,107 @@
+#ifndef DELAY_LINE_H
+#define DELAY_LINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include <media-io/audio-io.h>
+#include <util/circlebuf.h>
+
+#include "audio-packet.h"
+
+// Output side of catch-up and cut mode, which change the length of the audio. The analyzed
+// packets wait in the filter's output queue and are played at the pace of the input, stamped
+// with the input timestamp minus the target latency. The delay line is primed up to the
+// target first, underruns are filled with silence and the added latency is the age of the
+// audio played. Catch-up shortens segments while the latency is above the target. Cuts lower
+// the latency the delay line keeps, the timestamps stay continuous since a jump would leave a
+// gap in the OBS mix, and in pauses the delay line is held with silence until the cut latency
+// is recovered. The segment after a cut is crossfaded with the end of the queued output.
+struct delay_line {
+	/* latency catch-up */
+	std::atomic<bool> catchup_enabled{false};
+	std::atomic<uint64_t> target_ns{0};
+	std::atomic<double> max_speedup{0.0};
+
+	/* cut mode, fillers are removed instead of silenced */
+	std::atomic<bool> cut_enabled{false};
+	std::atomic<uint64_t> cut_max_frames_per_min{0};
+	// (time, frames) of the cuts in the last minute, only used by the job
+	std::deque<std::pair<uint64_t, uint64_t>> cut_history;
+	uint64_t cut_frames_last_min = 0;
+	// audio cut and not yet given back in pauses, the target is lowered by it
+	std::atomic<uint64_t> cut_latency_ns{0};
+	// the next segment is crossfaded with the end of the output queue, protected by its lock
+	bool cut_fade_pending = false;
+	std::vector<float> cut_fade_buffer;
+
+	/* playback, protected by the lock of the output queue */
+	bool primed = false;
+	// the packet being played and how many of its frames are left
+	struct cleanstream_audio_info packet = {};
+	uint32_t packet_left = 0;
+	// capture time of the next frame to play
+	uint64_t content_ts = 0;
+
+	// shortened segments, only used by the job
+	std::vector<float> stretch_buffers[MAX_AUDIO_CHANNELS];
+};
+
+// What playing an input packet's worth of the delay line did
+struct delay_line_playback {
+	// frames taken from the output queue, the rest of the packet has to be silence
+	uint32_t filled = 0;
+	// a pause was lengthened by the packet to recover cut latency
+	bool held = false;
+	// the delay line is primed, latency_ns is the age of the audio played
+	bool primed = false;
+	uint64_t latency_ns = 0;
+	// too far behind to catch up, e.g. after the source timestamps jumped: the queues have
+	// to be dropped
+	bool reset = false;
+};
+
+// The latency the delay line keeps: the catch-up target less the cut latency
+uint64_t delay_line_target_ns(const delay_line &line);
+
+// Playback speed for a segment: above 1 while the added latency exceeds the target
+double delay_line_catchup_speed(const delay_line &line, uint64_t added_latency_ns,
+				size_t frames, uint32_t sample_rate);
+
+// Shorten a planar segment by speed into the stretch buffers, segment then points to them.
+// Returns the number of frames left.
+size_t delay_line_shorten(delay_line &line, float **segment, size_t channels, size_t frames,
+			  double speed, uint32_t sample_rate);
+
+// Whether frames can be cut from the segment being analyzed, and record the cut if so. The
+// cut has to stay within the per-minute limit, and the queued_frames of output have to play
+// until the next segment is committed, hop_frames and processing_ms from now: a cut the delay
+// line cannot cover would come back as an underrun.
+bool delay_line_try_cut(delay_line &line, uint64_t frames, size_t queued_frames,
+			size_t hop_frames, int64_t processing_ms, uint32_t sample_rate);
+
+// Queue the crossfade for a cut of frames before the next segment. Called with the output
+// queue locked.
+void delay_line_queue_cut(delay_line &line, uint64_t frames, uint32_t sample_rate);
+
+// Crossfade the end of the output queue into the start of a segment following a cut, so the
+// audio before the cut joins the audio after it. Returns the segment frames used up, none
+// without a pending cut. Called with the output queue locked.
+size_t delay_line_crossfade_cut(delay_line &line, struct circlebuf *queues, size_t channels,
+				float *const *segment, size_t frames, uint32_t sample_rate);
+
+// Play the queued packets into out for an input packet of frames ending at input_end_ts.
+// Called with the output queue locked, out has room for frames per channel.
+delay_line_playback delay_line_play(delay_line &line, struct circlebuf *info_queue,
+				    struct circlebuf *queues, size_t channels,
+				    uint32_t sample_rate, uint64_t input_end_ts, uint32_t frames,
+				    uint8_t **out);
+
+// Start over after the output queue was emptied, called with it locked
+void delay_line_reset(delay_line &line);
+
+#endif // DELAY_LINE_H
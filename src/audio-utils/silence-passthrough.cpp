@@ -0,0 +1,91 @@
+#include "silence-passthrough.h"
+#include "audio-packet.h"
+
+#include <algorithm>
+#include <cmath>
+
+// packets with a peak below this (-80 dBFS) are digital silence
+#define SILENCE_PEAK 0.0001f
+// silence must last this long beyond the delay of the filter before it is collapsed
+#define SILENCE_HANGOVER_NS 500000000ULL
+
+void silence_passthrough_init(silence_passthrough &sp)
+{
+	circlebuf_init(&sp.preroll_info);
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++) {
+		circlebuf_init(&sp.preroll_buffers[c]);
+	}
+	sp.active = false;
+	sp.silent_run_ns = 0;
+}
+
+void silence_passthrough_free(silence_passthrough &sp)
+{
+	circlebuf_free(&sp.preroll_info);
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++) {
+		circlebuf_free(&sp.preroll_buffers[c]);
+	}
+}
+
+bool is_digital_silence(const struct obs_audio_data *audio, size_t channels)
+{
+	float peak = 0.0f;
+	for (size_t c = 0; c < channels; c++) {
+		const float *samples = (const float *)audio->data[c];
+		for (uint32_t i = 0; i < audio->frames; i++) {
+			peak = std::max(peak, fabsf(samples[i]));
+		}
+	}
+	return peak < SILENCE_PEAK;
+}
+
+bool silence_passthrough_detect(silence_passthrough &sp, const struct obs_audio_data *audio,
+				size_t channels, uint32_t sample_rate, uint64_t delay_ns)
+{
+	if (!is_digital_silence(audio, channels)) {
+		sp.silent_run_ns = 0;
+		return false;
+	}
+	sp.silent_run_ns += (uint64_t)audio->frames * 1000000000ULL / sample_rate;
+	return sp.active || sp.silent_run_ns >= SILENCE_HANGOVER_NS + delay_ns;
+}
+
+// Move all packets, info and audio, to the back of the other queues
+static void move_packets(struct circlebuf *from_info, struct circlebuf *from,
+			 struct circlebuf *to_info, struct circlebuf *to, size_t channels)
+{
+	circlebuf_push_back(to_info, from_info->data, from_info->size);
+	circlebuf_pop_front(from_info, nullptr, from_info->size);
+	for (size_t c = 0; c < channels; c++) {
+		circlebuf_push_back(&to[c], from[c].data, from[c].size);
+		circlebuf_pop_front(&from[c], nullptr, from[c].size);
+	}
+}
+
+void silence_passthrough_begin(silence_passthrough &sp, struct circlebuf *info_queue,
+			       struct circlebuf *queues, size_t channels)
+{
+	move_packets(info_queue, queues, &sp.preroll_info, sp.preroll_buffers, channels);
+	sp.active = true;
+}
+
+void silence_passthrough_push(silence_passthrough &sp, const struct obs_audio_data *audio,
+			      size_t channels)
+{
+	struct cleanstream_audio_info info = {0};
+	info.frames = audio->frames;
+	info.timestamp = audio->timestamp;
+	info.source_frames = audio->frames;
+	circlebuf_push_back(&sp.preroll_info, &info, sizeof(info));
+	for (size_t c = 0; c < channels; c++) {
+		circlebuf_push_back(&sp.preroll_buffers[c], audio->data[c],
+				    audio->frames * sizeof(float));
+	}
+}
+
+void silence_passthrough_end(silence_passthrough &sp, struct circlebuf *info_queue,
+			     struct circlebuf *queues, size_t channels)
+{
+	move_packets(&sp.preroll_info, sp.preroll_buffers, info_queue, queues, channels);
+	sp.active = false;
+}
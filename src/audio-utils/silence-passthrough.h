@@ -0,0 +1,48 @@
+#ifndef SILENCE_PASSTHROUGH_H
+#define SILENCE_PASSTHROUGH_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <obs-module.h>
+#include <util/circlebuf.h>
+
+// Digital silence fast path, for muted mics and silent sources. Once the silence outlasts the
+// delay of the filter, the delay only holds silence: the input not analyzed yet and the
+// silence that follows go into the pre-roll instead of being resampled and analyzed. The
+// pre-roll is played like the output queue, so the output delay and the timestamps continue
+// as before. Only used on the audio thread.
+struct silence_passthrough {
+	bool enabled = true;
+	// passing silence through the pre-roll
+	bool active = false;
+	uint64_t silent_run_ns = 0;
+	struct circlebuf preroll_info;
+	struct circlebuf preroll_buffers[MAX_AUDIO_CHANNELS];
+};
+
+void silence_passthrough_init(silence_passthrough &sp);
+void silence_passthrough_free(silence_passthrough &sp);
+
+// Whether a packet peaks below -80 dBFS
+bool is_digital_silence(const struct obs_audio_data *audio, size_t channels);
+
+// Track an input packet, returns true if it is to be passed through: it is digital silence
+// that lasted delay_ns, the delay of the filter, and a hangover beyond it
+bool silence_passthrough_detect(silence_passthrough &sp, const struct obs_audio_data *audio,
+				size_t channels, uint32_t sample_rate, uint64_t delay_ns);
+
+// Start passing through, the packets of the input queue become the start of the pre-roll.
+// Called with the input queue locked.
+void silence_passthrough_begin(silence_passthrough &sp, struct circlebuf *info_queue,
+			       struct circlebuf *queues, size_t channels);
+
+// Queue a silent packet in the pre-roll
+void silence_passthrough_push(silence_passthrough &sp, const struct obs_audio_data *audio,
+			      size_t channels);
+
+// Stop passing through, the pre-roll goes to the back of the queues. Called with them locked.
+void silence_passthrough_end(silence_passthrough &sp, struct circlebuf *info_queue,
+			     struct circlebuf *queues, size_t channels);
+
+#endif // SILENCE_PASSTHROUGH_H
@@ -0,0 +1,170 @@
+#include "time-stretch.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TIME_STRETCH_SSE
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define TIME_STRETCH_NEON
+#endif
+
+// analysis/synthesis window and the search range around the nominal position
+#define WINDOW_MS 20
+#define TOLERANCE_MS 5
+// quiet windows, relative to the segment RMS, take this much more of the compression
+#define QUIET_RMS_RATIO 0.25f
+#define QUIET_WEIGHT 4.0
+
+float dot_product(const float *a, const float *b, size_t n)
+{
+	size_t i = 0;
+	float sum = 0.0f;
+#if defined(TIME_STRETCH_SSE)
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	for (; i + 8 <= n; i += 8) {
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		acc1 = _mm_add_ps(acc1,
+				  _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+	sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(TIME_STRETCH_NEON)
+	float32x4_t acc0 = vdupq_n_f32(0.0f);
+	float32x4_t acc1 = vdupq_n_f32(0.0f);
+	for (; i + 8 <= n; i += 8) {
+		acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+		acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+	}
+	const float32x4_t acc = vaddq_f32(acc0, acc1);
+	sum = vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1) + vgetq_lane_f32(acc, 2) +
+	      vgetq_lane_f32(acc, 3);
+#endif
+	for (; i < n; i++) {
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+// synthesis windows overlap by half
+static size_t window_frames(uint32_t sample_rate)
+{
+	return (size_t)(sample_rate * WINDOW_MS / 1000) & ~(size_t)1;
+}
+
+size_t time_compress(const float *const *in, size_t channels, size_t frames, double speed,
+		     uint32_t sample_rate, std::vector<float> *out,
+		     std::vector<size_t> *window_positions)
+{
+	const size_t window = window_frames(sample_rate);
+	const size_t hop = window / 2;
+	if (window_positions != nullptr) {
+		window_positions->clear();
+	}
+	const long tolerance = (long)(sample_rate * TOLERANCE_MS / 1000);
+
+	// number of synthesis windows, the output is window + (n_windows - 1) * hop long
+	const double target_frames = (double)frames / speed;
+	const long n_windows = std::lround((target_frames - (double)window) / (double)hop) + 1;
+	if (speed <= 1.0 || frames < 4 * window || n_windows < 2 ||
+	    window + (size_t)(n_windows - 1) * hop >= frames) {
+		for (size_t c = 0; c < channels; c++) {
+			out[c].assign(in[c], in[c] + frames);
+		}
+		return frames;
+	}
+	const size_t out_frames = window + (size_t)(n_windows - 1) * hop;
+
+	// mono mix for the analysis
+	std::vector<float> mono(in[0], in[0] + frames);
+	for (size_t c = 1; c < channels; c++) {
+		for (size_t i = 0; i < frames; i++) {
+			mono[i] += in[c][i];
+		}
+	}
+
+	// spread the frames to drop over the hops, quiet hops take more of them
+	const double uniform_advance = (double)(frames - window) / (double)(n_windows - 1);
+	const float segment_rms = std::sqrt(dot_product(mono.data(), mono.data(), frames) /
+					    (float)frames);
+	std::vector<double> weights(n_windows, 1.0);
+	double weight_sum = 0.0;
+	for (long k = 1; k < n_windows; k++) {
+		const size_t pos = std::min((size_t)(uniform_advance * (double)k), frames - window);
+		const float rms = std::sqrt(dot_product(mono.data() + pos, mono.data() + pos, window) /
+					    (float)window);
+		weights[k] = rms < segment_rms * QUIET_RMS_RATIO ? QUIET_WEIGHT : 1.0;
+		weight_sum += weights[k];
+	}
+	const double extra = (double)(frames - window) - (double)((n_windows - 1) * hop);
+
+	// periodic Hann, sums to one at 50% overlap
+	std::vector<float> hann(window);
+	for (size_t n = 0; n < window; n++) {
+		hann[n] = 0.5f - 0.5f * std::cos(6.28318530718f * (float)n / (float)window);
+	}
+
+	for (size_t c = 0; c < channels; c++) {
+		out[c].assign(out_frames, 0.0f);
+	}
+
+	double nominal = 0.0;
+	long prev_pos = 0;
+	const long max_pos = (long)(frames - window);
+	for (long k = 0; k < n_windows; k++) {
+		long pos = 0;
+		if (k == n_windows - 1) {
+			pos = max_pos;
+		} else if (k > 0) {
+			nominal += (double)hop + extra * weights[k] / weight_sum;
+			// pick the position that best continues the previous window
+			const long natural = std::min(prev_pos + (long)hop, max_pos);
+			const long center = std::lround(nominal);
+			const long lo = std::max(0L, center - tolerance);
+			const long hi = std::min(max_pos, center + tolerance);
+			float best = -INFINITY;
+			pos = std::clamp(center, 0L, max_pos);
+			for (long p = lo; p <= hi; p++) {
+				const float corr =
+					dot_product(mono.data() + natural, mono.data() + p, window);
+				if (corr > best) {
+					best = corr;
+					pos = p;
+				}
+			}
+		}
+		prev_pos = pos;
+		if (window_positions != nullptr) {
+			window_positions->push_back((size_t)pos);
+		}
+
+		// overlap-add, the outer halves of the first and last window are not faded
+		const size_t out_pos = (size_t)k * hop;
+		for (size_t c = 0; c < channels; c++) {
+			const float *src = in[c] + pos;
+			float *dst = out[c].data() + out_pos;
+			for (size_t n = 0; n < window; n++) {
+				const bool flat = (k == 0 && n < hop) ||
+						  (k == n_windows - 1 && n >= hop);
+				dst[n] += src[n] * (flat ? 1.0f : hann[n]);
+			}
+		}
+	}
+	return out_frames;
+}
+
+size_t time_compress_source_frame(const std::vector<size_t> &window_positions,
+				  uint32_t sample_rate, size_t out_frame)
+{
+	if (window_positions.empty()) {
+		return out_frame;
+	}
+	// window k starts at output frame k * hop
+	const size_t hop = window_frames(sample_rate) / 2;
+	const size_t k = std::min(out_frame / hop, window_positions.size() - 1);
+	return window_positions[k] + (out_frame - k * hop);
+}
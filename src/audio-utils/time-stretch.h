@@ -0,0 +1,25 @@
+#ifndef TIME_STRETCH_H
+#define TIME_STRETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Shorten planar float audio by speed (> 1) with WSOLA, keeping the pitch.
+// The first and last half window are copied unchanged so consecutive segments join without
+// a seam. Quiet parts are compressed more than loud parts.
+// out receives one vector per channel, returns the number of output frames.
+// window_positions, if given, receives the input frame each synthesis window was taken from,
+// empty when the audio was copied unchanged.
+size_t time_compress(const float *const *in, size_t channels, size_t frames, double speed,
+		     uint32_t sample_rate, std::vector<float> *out,
+		     std::vector<size_t> *window_positions = nullptr);
+
+// Input frame of an output frame of time_compress, from its window positions
+size_t time_compress_source_frame(const std::vector<size_t> &window_positions,
+				  uint32_t sample_rate, size_t out_frame);
+
+// Dot product of two float arrays, vectorized where available
+float dot_product(const float *a, const float *b, size_t n);
+
+#endif // TIME_STRETCH_H
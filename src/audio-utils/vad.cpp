@@ -0,0 +1,45 @@
+#include "vad.h"
+
+#include <cmath>
+
+void high_pass_filter(float *pcmf32, size_t pcm32f_size, float cutoff, uint32_t sample_rate)
+{
+	const float rc = 1.0f / (2.0f * 3.14159265358979f * cutoff);
+	const float dt = 1.0f / (float)sample_rate;
+	const float alpha = dt / (rc + dt);
+
+	float y = pcmf32[0];
+
+	for (size_t i = 1; i < pcm32f_size; i++) {
+		y = alpha * (y + pcmf32[i] - pcmf32[i - 1]);
+		pcmf32[i] = y;
+	}
+}
+
+bool vad_simple(float *pcmf32, size_t pcm32f_size, uint32_t sample_rate, float vad_thold,
+		float freq_thold, float *energy)
+{
+	const uint64_t n_samples = pcm32f_size;
+
+	if (freq_thold > 0.0f) {
+		high_pass_filter(pcmf32, pcm32f_size, freq_thold, sample_rate);
+	}
+
+	float energy_all = 0.0f;
+
+	for (uint64_t i = 0; i < n_samples; i++) {
+		energy_all += fabsf(pcmf32[i]);
+	}
+
+	energy_all /= (float)n_samples;
+
+	if (energy != nullptr) {
+		*energy = energy_all;
+	}
+
+	if (energy_all < vad_thold) {
+		return false;
+	}
+
+	return true;
+}
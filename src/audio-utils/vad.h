@@ -0,0 +1,16 @@
+#ifndef VAD_H
+#define VAD_H
+
+#include <cstddef>
+#include <cstdint>
+
+// One pole high pass filter, in place
+void high_pass_filter(float *pcmf32, size_t pcm32f_size, float cutoff, uint32_t sample_rate);
+
+// VAD (voice activity detection), return true if speech detected.
+// The audio is high pass filtered in place when freq_thold is set. energy receives the mean
+// absolute level the threshold was compared with.
+bool vad_simple(float *pcmf32, size_t pcm32f_size, uint32_t sample_rate, float vad_thold,
+		float freq_thold, float *energy = nullptr);
+
+#endif // VAD_H
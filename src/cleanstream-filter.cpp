@@ -2,27 +2,42 @@
 #include <media-io/audio-resampler.h>
 #include <util/circlebuf.h>
 #include <util/darray.h>
-
-#ifdef _WIN32
-#include <fstream>
-#define NOMINMAX
-#include <windows.h>
-#undef max
-#endif
+#include <util/platform.h>
 
 #include <string>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <cinttypes>
 #include <algorithm>
 #include <regex>
 #include <functional>
+#include <vector>
 
 #include <whisper.h>
+#include <obs-frontend-api.h>
 
 #include "cleanstream-filter.h"
+#include "model-utils/model-catalog.h"
 #include "model-utils/model-downloader.h"
+#include "model-utils/model-store.h"
 #include "whisper-utils/whisper-language.h"
+#include "whisper-utils/inference-thread.h"
+#include "whisper-utils/inference-pool.h"
+#include "whisper-utils/shadow-inference.h"
+#include "whisper-utils/segment-packer.h"
+#include "whisper-utils/detection.h"
+#include "whisper-utils/lexicon.h"
+#include "diagnostics/control-plane.h"
+#include "diagnostics/flight-recorder.h"
+#include "diagnostics/session-report.h"
+#include "diagnostics/tracepoints.h"
+#include "audio-utils/delay-line.h"
+#include "audio-utils/silence-passthrough.h"
+#include "audio-utils/time-stretch.h"
+#include "audio-utils/vad.h"
+#include "whisper-utils/whisper-model.h"
 
 #include "plugin-support.h"
 
@@ -34,7 +49,10 @@
 #define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
 #define debug(format, ...) do_log(LOG_DEBUG, format, ##__VA_ARGS__)
 
-#define MAX_PREPROC_CHANNELS 2
+// channels analyzed on their own with per-channel analysis, the front left and right
+#define MAX_ANALYZED_CHANNELS 2
+// windows of one filter analyzed at once, each needs its own whisper state
+#define MAX_PARALLEL_WINDOWS 4
 
 // buffer size in msec
 #define BUFFER_SIZE_MSEC 1010
@@ -42,6 +60,17 @@
 #define WHISPER_FRAME_SIZE 16160
 // overlap in msec
 #define OVERLAP_SIZE_MSEC 340
+// token limit from which decoding is ended once the rules decided the result
+#define EARLY_STOP_MIN_TOKENS 8
+// upper bound of analyzed segments per second, with the overlap at 75% of the segment
+#define FLIGHT_RECORDER_SEGMENTS_PER_SEC 4
+// at most one automatic flight recorder dump per minute
+#define FLIGHT_RECORDER_DUMP_COOLDOWN_NS 60000000000ULL
+// in analysis only mode audio queued beyond this is skipped instead of analyzed late
+#define TAP_MAX_BACKLOG_MSEC 3000
+// control plane benchmark from the Tools menu: an update of every filter every 50 ms
+#define CONTROL_PLANE_BENCHMARK_SEC 30
+#define CONTROL_PLANE_INTERVAL_MSEC 50
 
 #define VAD_THOLD 0.0001f
 #define FREQ_THOLD 100.0f
@@ -50,10 +79,33 @@
 
 #define MT_ obs_module_text
 
-// Audio packet info
-struct cleanstream_audio_info {
-	uint32_t frames;
-	uint64_t timestamp;
+// A window being analyzed. Concurrent windows of a filter each use their own slot.
+struct analysis_slot {
+	// held while the state is used or replaced
+	std::mutex mutex;
+	// the model the states were created for
+	std::shared_ptr<struct whisper_context> ctx;
+	// the state of the mix, or of each channel with per-channel analysis
+	struct whisper_state *states[MAX_ANALYZED_CHANNELS] = {};
+	audio_resampler_t *resampler = nullptr;
+	audio_resampler_t *channel_resamplers[MAX_ANALYZED_CHANNELS] = {};
+	// taken by a job, protected by the filter's slots_mutex
+	bool busy = false;
+	// the window's audio and the audio to output
+	std::vector<float> window[MAX_AUDIO_CHANNELS];
+	std::vector<float> output[MAX_AUDIO_CHANNELS];
+	// the 16 kHz input time compressed for the analysis, and where its windows came from
+	std::vector<float> compressed[1];
+	std::vector<size_t> compressed_positions;
+};
+
+// The filler and beep expressions of the settings, compiled when they change. An empty or
+// invalid expression is null.
+struct detection_rules {
+	std::string filler_source;
+	std::string beep_source;
+	std::unique_ptr<std::regex> filler;
+	std::unique_ptr<std::regex> beep;
 };
 
 struct cleanstream_data {
@@ -69,24 +121,101 @@ struct cleanstream_data {
 	size_t last_num_frames;
 
 	/* PCM buffers */
-	float *copy_buffers[MAX_PREPROC_CHANNELS];
-	DARRAY(float) copy_output_buffers[MAX_PREPROC_CHANNELS];
+	float *copy_buffers[MAX_AUDIO_CHANNELS];
 	struct circlebuf info_buffer;
 	struct circlebuf info_out_buffer;
-	struct circlebuf input_buffers[MAX_PREPROC_CHANNELS];
-	struct circlebuf output_buffers[MAX_PREPROC_CHANNELS];
+	struct circlebuf input_buffers[MAX_AUDIO_CHANNELS];
+	struct circlebuf output_buffers[MAX_AUDIO_CHANNELS];
+	// incremented when the buffers are reset, a segment in flight is then dropped
+	std::atomic<uint64_t> buffer_generation;
+
+	/* digital silence fast path, only used on the audio thread */
+	struct silence_passthrough silence;
 
-	/* Resampler */
-	audio_resampler_t *resampler;
+	/* Resampler, analysis uses the resamplers of the slots */
 	audio_resampler_t *resampler_back;
 
 	/* whisper */
 	std::string whisper_model_path = "models/ggml-tiny.en.bin";
-	struct whisper_context *whisper_context;
+	// the model is shared with other filters using the same file, the states are in the
+	// analysis slots
+	std::shared_ptr<struct whisper_context> whisper_context;
+	// whether whisper_context is set, checked on the audio thread without the mutex
+	std::atomic<bool> model_loaded;
 	whisper_full_params whisper_params;
 
-	// Use std for thread and mutex
-	std::thread whisper_thread;
+	/* inference pool jobs */
+	// at most parallel_windows jobs per filter are queued or running on the inference pool,
+	// each analyzes windows on its own slot
+	std::atomic<int> jobs_running;
+	std::atomic<int> parallel_windows;
+	// whisper compute threads of a job, for the pool to fit concurrent jobs into the cores
+	std::atomic<int> job_threads;
+	// analyze each channel on its own, e.g. a speaker on each side of a stereo source
+	std::atomic<bool> per_channel;
+	// wait this long for segments of other filters to share the inference, 0 disables
+	std::atomic<uint32_t> pack_wait_ms;
+	// mix the packed segments like a bus instead of transcribing each of them
+	std::atomic<bool> mix_sources;
+	// time compress the analysis input by this factor, 1 disables
+	std::atomic<double> analysis_speed;
+	// size the encoder context to the analysis input instead of whisper's 30 s
+	std::atomic<bool> trim_audio_ctx;
+	std::mutex slots_mutex;
+	struct analysis_slot slots[MAX_PARALLEL_WINDOWS];
+	// windows are numbered when taken from the input buffer, under whisper_buf_mutex, and
+	// output in that order: a window finishing before an earlier one waits for its turn
+	uint64_t next_window_sequence;
+	std::mutex commit_mutex;
+	std::condition_variable commit_cv;
+	uint64_t next_commit_sequence;
+	std::mutex job_mutex;
+	std::condition_variable job_cv;
+	std::atomic<bool> stopping;
+	std::atomic<int> inference_priority;
+
+	/* model lifecycle */
+	// the model is loaded by the filter's job once the filter receives audio while active
+	std::atomic<bool> model_requested;
+	// set when loading failed, cleared when the model path changes or a download finishes
+	std::atomic<bool> model_load_failed;
+	// last time audio was received while active, used to unload the model when idle
+	std::atomic<uint64_t> last_audio_ns;
+	// unload the model after this many ms without audio, 0 keeps it loaded
+	std::atomic<uint64_t> unload_idle_ms;
+
+	/* shadow config, compared against the live one on the same audio */
+	shadow_runner shadow;
+
+	/* flight recorder of the last minutes of analyzed segments */
+	flight_recorder recorder;
+	int recorder_minutes;
+	// dump automatically when added latency or inference time exceed these, 0 disables
+	std::atomic<uint32_t> recorder_latency_ms;
+	std::atomic<uint32_t> recorder_inference_ms;
+	// reason of a dump for the housekeeping to write, nullptr if none is requested
+	std::atomic<const char *> recorder_dump_reason;
+	uint64_t recorder_last_auto_dump_ns;
+	// delay between the audio entering and leaving the filter
+	std::atomic<uint64_t> added_latency_ns;
+
+	/* performance report written when streaming or recording stops */
+	session_stats stats;
+	// reason of a report for the housekeeping to write, nullptr if none is requested
+	std::atomic<const char *> report_reason;
+	// passing audio through because the model is not loaded, only used on the audio thread
+	bool failing_open;
+
+	/* analysis only mode, the audio is passed through unchanged and the detections only go
+	 * to the session report */
+	std::atomic<bool> tap_mode;
+
+	/* output of catch-up and cut mode, the playback is protected by whisper_outbuf_mutex */
+	struct delay_line delay;
+
+	/* inference thread placement, the config is protected by whisper_ctx_mutex */
+	inference_thread_config thread_config;
+	int numa_node;
 
 	/* output data */
 	struct obs_audio_data output_audio;
@@ -97,8 +226,19 @@ struct cleanstream_data {
 	bool do_silence;
 	bool vad_enabled;
 	int log_level;
-	const char *detect_regex;
-	const char *beep_regex;
+
+	/* filler and beep expressions */
+	std::mutex rules_mutex;
+	// protected by rules_mutex, inference holds a reference while classifying
+	std::shared_ptr<const struct detection_rules> rules;
+
+	/* precompiled word list, replaced when the file changes */
+	std::mutex lexicon_mutex;
+	// protected by lexicon_mutex, inference holds a reference while matching
+	std::string lexicon_path;
+	std::shared_ptr<const struct lexicon> lexicon;
+	// a failed load is logged once
+	std::atomic<bool> lexicon_failed;
 	bool log_words;
 	bool active;
 };
@@ -107,52 +247,6 @@ std::mutex whisper_buf_mutex;
 std::mutex whisper_outbuf_mutex;
 std::mutex whisper_ctx_mutex;
 
-void whisper_loop(void *data);
-
-void high_pass_filter(float *pcmf32, size_t pcm32f_size, float cutoff, uint32_t sample_rate)
-{
-	const float rc = 1.0f / (2.0f * (float)M_PI * cutoff);
-	const float dt = 1.0f / (float)sample_rate;
-	const float alpha = dt / (rc + dt);
-
-	float y = pcmf32[0];
-
-	for (size_t i = 1; i < pcm32f_size; i++) {
-		y = alpha * (y + pcmf32[i] - pcmf32[i - 1]);
-		pcmf32[i] = y;
-	}
-}
-
-// VAD (voice activity detection), return true if speech detected
-bool vad_simple(float *pcmf32, size_t pcm32f_size, uint32_t sample_rate, float vad_thold,
-		float freq_thold, bool verbose)
-{
-	const uint64_t n_samples = pcm32f_size;
-
-	if (freq_thold > 0.0f) {
-		high_pass_filter(pcmf32, pcm32f_size, freq_thold, sample_rate);
-	}
-
-	float energy_all = 0.0f;
-
-	for (uint64_t i = 0; i < n_samples; i++) {
-		energy_all += fabsf(pcmf32[i]);
-	}
-
-	energy_all /= (float)n_samples;
-
-	if (verbose) {
-		blog(LOG_INFO, "%s: energy_all: %f, vad_thold: %f, freq_thold: %f", __func__,
-		     energy_all, vad_thold, freq_thold);
-	}
-
-	if (energy_all < vad_thold) {
-		return false;
-	}
-
-	return true;
-}
-
 float avg_energy_in_window(const float *pcmf32, size_t window_i, uint64_t n_samples_window)
 {
 	float energy_in_window = 0.0f;
@@ -234,52 +328,28 @@ inline enum speaker_layout convert_speaker_layout(uint8_t channels)
 	}
 }
 
-struct whisper_context *init_whisper_context(const std::string &model_path_)
+// Called with the slot's mutex held
+void free_slot_state(struct analysis_slot &slot)
 {
-	struct whisper_context_params cparams;
-#ifdef LOCALVOCAL_WITH_CUDA
-	cparams.use_gpu = true;
-#else
-	cparams.use_gpu = false;
-#endif
-
-	char *model_path_ctr = obs_module_file(model_path_.c_str());
-	std::string model_path(model_path_ctr);
-	bfree(model_path_ctr);
-
-#ifdef _WIN32
-	// convert model path UTF8 to wstring (wchar_t) for whisper
-	int count = MultiByteToWideChar(CP_UTF8, 0, model_path.c_str(), (int)model_path.length(),
-					NULL, 0);
-	std::wstring model_path_ws(count, 0);
-	MultiByteToWideChar(CP_UTF8, 0, model_path.c_str(), (int)model_path.length(),
-			    &model_path_ws[0], count);
-
-	// Read model into buffer
-	std::ifstream modelFile(model_path_ws, std::ios::binary);
-	if (!modelFile.is_open()) {
-		obs_log(LOG_ERROR, "Failed to open whisper model file %s", model_path.c_str());
-		return nullptr;
+	for (struct whisper_state *&state : slot.states) {
+		if (state != nullptr) {
+			whisper_free_state(state);
+			state = nullptr;
+		}
 	}
-	modelFile.seekg(0, std::ios::end);
-	const size_t modelFileSize = modelFile.tellg();
-	modelFile.seekg(0, std::ios::beg);
-	std::vector<char> modelBuffer(modelFileSize);
-	modelFile.read(modelBuffer.data(), modelFileSize);
-	modelFile.close();
-
-	// Initialize whisper
-	struct whisper_context *ctx =
-		whisper_init_from_buffer_with_params(modelBuffer.data(), modelFileSize, cparams);
-#else
-	struct whisper_context *ctx =
-		whisper_init_from_file_with_params(model_path.c_str(), cparams);
-#endif
-	if (ctx == nullptr) {
-		error("Failed to load whisper model");
-		return nullptr;
+	slot.ctx.reset();
+}
+
+// Release the filter's whisper states and its reference to the shared model, waits for
+// running inferences. Called with whisper_ctx_mutex held.
+void release_whisper_model(struct cleanstream_data *gf)
+{
+	for (struct analysis_slot &slot : gf->slots) {
+		std::lock_guard<std::mutex> lock(slot.mutex);
+		free_slot_state(slot);
 	}
-	return ctx;
+	gf->whisper_context.reset();
+	gf->model_loaded = false;
 }
 
 std::string to_timestamp(int64_t t)
@@ -295,104 +365,302 @@ std::string to_timestamp(int64_t t)
 	return std::string(buf);
 }
 
-enum DetectionResult {
-	DETECTION_RESULT_UNKNOWN = 0,
-	DETECTION_RESULT_SILENCE = 1,
-	DETECTION_RESULT_SPEECH = 2,
-	DETECTION_RESULT_FILLER = 3,
-	DETECTION_RESULT_BEEP = 4,
+// Classify a normalized transcription with the filter's lexicon, matched receives the phrase
+int detect_lexicon(struct cleanstream_data *gf, const std::string &text_lower,
+		   std::string *matched)
+{
+	std::shared_ptr<const struct lexicon> lexicon;
+	{
+		std::lock_guard<std::mutex> lock(gf->lexicon_mutex);
+		lexicon = gf->lexicon;
+	}
+	if (lexicon == nullptr) {
+		return DETECTION_RESULT_SPEECH;
+	}
+	return lexicon_match(*lexicon, text_lower, matched);
+}
+
+std::shared_ptr<const struct detection_rules> current_rules(struct cleanstream_data *gf)
+{
+	std::lock_guard<std::mutex> lock(gf->rules_mutex);
+	return gf->rules;
+}
+
+// Compile the expressions if they changed, an invalid one is reported and disabled
+void update_rules(struct cleanstream_data *gf, const char *filler_source, const char *beep_source)
+{
+	const std::shared_ptr<const struct detection_rules> current = current_rules(gf);
+	if (current->filler_source == filler_source && current->beep_source == beep_source) {
+		return;
+	}
+	auto rules = std::make_shared<struct detection_rules>();
+	rules->filler_source = filler_source;
+	rules->beep_source = beep_source;
+	auto compile = [](const std::string &source, std::unique_ptr<std::regex> &regex) {
+		if (source.empty()) {
+			return;
+		}
+		try {
+			regex = std::make_unique<std::regex>(source);
+		} catch (const std::regex_error &e) {
+			error("Regex error in '%s': %s", source.c_str(), e.what());
+		}
+	};
+	compile(rules->filler_source, rules->filler);
+	compile(rules->beep_source, rules->beep);
+	std::lock_guard<std::mutex> lock(gf->rules_mutex);
+	gf->rules = rules;
+}
+
+// Classify a normalized transcription with the filter's regular expressions, then its lexicon,
+// matched receives the text matched by the filler or beep expression or the lexicon phrase
+int detect_text(struct cleanstream_data *gf, const std::string &text_lower,
+		std::string *matched = nullptr)
+{
+	const std::shared_ptr<const struct detection_rules> rules = current_rules(gf);
+	const int result =
+		classify_text(text_lower, rules->filler.get(), rules->beep.get(), matched);
+	return result == DETECTION_RESULT_SPEECH ? detect_lexicon(gf, text_lower, matched)
+						 : result;
+}
+
+// A transcription being decoded: the filter's rules, to end it once its result is decided
+struct decode_watch {
+	std::shared_ptr<const struct detection_rules> rules;
+	// a decoder was ended early
+	std::atomic<bool> stopped{false};
 };
 
-int run_whisper_inference(struct cleanstream_data *gf, const float *pcm32f_data, size_t pcm32f_size)
+// whisper's logits filter: once the tokens so far decide the result, only the end of the text
+// is left to decode. Decoders of a beam search call it with their own tokens.
+void decode_watch_logits(struct whisper_context *ctx, struct whisper_state *,
+			 const whisper_token_data *tokens, int n_tokens, float *logits,
+			 void *user_data)
 {
-	do_log(gf->log_level, "%s: processing %d samples, %.3f sec, %d threads", __func__,
-	       int(pcm32f_size), float(pcm32f_size) / WHISPER_SAMPLE_RATE,
-	       gf->whisper_params.n_threads);
+	struct decode_watch *watch = static_cast<struct decode_watch *>(user_data);
+	if (!watch->rules || (!watch->rules->filler && !watch->rules->beep)) {
+		return;
+	}
+	const whisper_token eot = whisper_token_eot(ctx);
+	std::string text;
+	for (int i = 0; i < n_tokens; i++) {
+		if (tokens[i].id < eot) {
+			text += whisper_token_to_str(ctx, tokens[i].id);
+		}
+	}
+	if (classify_prefix(normalize_text(text.c_str()), watch->rules->filler.get(),
+			    watch->rules->beep.get()) == DETECTION_RESULT_UNKNOWN) {
+		return;
+	}
+	const int n_vocab = whisper_n_vocab(ctx);
+	for (int i = 0; i < n_vocab; i++) {
+		if (i != eot) {
+			logits[i] = -INFINITY;
+		}
+	}
+	watch->stopped = true;
+}
 
-	std::lock_guard<std::mutex> lock(whisper_ctx_mutex);
-	if (gf->whisper_context == nullptr) {
+// Run the live config on a 16 kHz segment with the slot's whisper state of the channel,
+// text_lower receives the normalized transcription and matched the text matched by the
+// detection rules. timestamp_ns is the time of the first sample, to line up mixed sources.
+int run_whisper_inference(struct cleanstream_data *gf, struct analysis_slot &slot,
+			  size_t channel, const float *pcm32f_data, size_t pcm32f_size,
+			  uint64_t timestamp_ns, std::string &text_lower, std::string &matched)
+{
+	// take what the inference needs and run it without whisper_ctx_mutex, so windows on
+	// other slots run concurrently
+	std::shared_ptr<struct whisper_context> ctx;
+	whisper_full_params params;
+	std::string language;
+	std::string initial_prompt;
+	{
+		std::lock_guard<std::mutex> lock(whisper_ctx_mutex);
+		ctx = gf->whisper_context;
+		params = gf->whisper_params;
+		// the strings belong to the settings, which may change while the inference runs
+		language = params.language != nullptr ? params.language : "";
+		initial_prompt = params.initial_prompt != nullptr ? params.initial_prompt : "";
+	}
+	if (ctx == nullptr) {
 		warn("whisper context is null");
 		return DETECTION_RESULT_UNKNOWN;
 	}
+	params.language = params.language != nullptr ? language.c_str() : nullptr;
+	params.initial_prompt = params.initial_prompt != nullptr ? initial_prompt.c_str() : nullptr;
 
-	// run the inference
-	int whisper_full_result = -1;
+	do_log(gf->log_level, "%s: processing %d samples, %.3f sec, %d threads", __func__,
+	       int(pcm32f_size), float(pcm32f_size) / WHISPER_SAMPLE_RATE, params.n_threads);
+
+	std::unique_lock<std::mutex> slot_lock(slot.mutex);
+	if (slot.ctx != ctx) {
+		// the model was reloaded
+		free_slot_state(slot);
+		slot.ctx = ctx;
+	}
+	if (slot.states[channel] == nullptr) {
+		// first window of the channel on this slot
+		slot.states[channel] = whisper_init_state(ctx.get());
+		if (slot.states[channel] == nullptr) {
+			error("Failed to create a whisper state");
+			return DETECTION_RESULT_UNKNOWN;
+		}
+	}
+	struct whisper_state *state = slot.states[channel];
+
+	const uint32_t pack_wait_us = gf->pack_wait_ms * 1000;
+	// the channels of per-channel analysis are not mixed back together
+	const enum pack_mode mode = gf->mix_sources && !(gf->per_channel && gf->channels > 1)
+					    ? PACK_MIX
+					    : PACK_CONCATENATE;
+
+	// timestamps are mapped back below. Mixed sources are lined up by their timestamps, so
+	// they are not compressed.
+	const double analysis_speed =
+		pack_wait_us > 0 && mode == PACK_MIX ? 1.0 : (double)gf->analysis_speed;
+	if (analysis_speed > 1.0) {
+		const size_t compressed_size =
+			time_compress(&pcm32f_data, 1, pcm32f_size, analysis_speed,
+				      WHISPER_SAMPLE_RATE, slot.compressed,
+				      &slot.compressed_positions);
+		pcm32f_data = slot.compressed[0].data();
+		pcm32f_size = compressed_size;
+	} else {
+		slot.compressed_positions.clear();
+	}
+	const bool trim_audio_ctx = gf->trim_audio_ctx && pack_wait_us == 0;
+	if (trim_audio_ctx) {
+		// whisper's context positions are 20 ms each, a packed input has its own length
+		params.audio_ctx = (int)((pcm32f_size * 1000 / WHISPER_SAMPLE_RATE + 19) / 20);
+	}
+
+	// end the decoding once the rules decided the result, not for packed calls, whose tokens
+	// belong to other filters too, nor with a low token limit, where the few passes left to
+	// save do not pay for matching the rules after every pass
+	struct decode_watch watch;
+	if (pack_wait_us == 0 &&
+	    (params.max_tokens == 0 || params.max_tokens >= EARLY_STOP_MIN_TOKENS)) {
+		watch.rules = current_rules(gf);
+		params.logits_filter_callback = decode_watch_logits;
+		params.logits_filter_callback_user_data = &watch;
+	}
+
+	// run the inference, packed with the segments of other filters when enabled
+	packed_result packed;
 	try {
-		whisper_full_result = whisper_full(gf->whisper_context, gf->whisper_params,
-						   pcm32f_data, (int)pcm32f_size);
+		packed = segment_packer_run(ctx, state, slot_lock, params, mode, pcm32f_data,
+					    pcm32f_size, timestamp_ns, pack_wait_us);
 	} catch (const std::exception &e) {
-		error("Whisper exception: %s. Filter restart is required", e.what());
-		whisper_free(gf->whisper_context);
-		gf->whisper_context = nullptr;
+		error("Whisper exception: %s. Reloading the model", e.what());
+		free_slot_state(slot);
+		slot_lock.unlock();
+		std::lock_guard<std::mutex> lock(whisper_ctx_mutex);
+		release_whisper_model(gf);
 		return DETECTION_RESULT_UNKNOWN;
 	}
 
-	if (whisper_full_result != 0) {
-		warn("failed to process audio, error %d", whisper_full_result);
+	session_stats_add_inference(gf->stats, 1.0 / packed.batch_size, watch.stopped);
+
+	if (packed.status != 0) {
+		warn("failed to process audio, error %d", packed.status);
 		return DETECTION_RESULT_UNKNOWN;
 	} else {
-		const int n_segment = 0;
-		const char *text = whisper_full_get_segment_text(gf->whisper_context, n_segment);
-		const int64_t t0 = whisper_full_get_segment_t0(gf->whisper_context, n_segment);
-		const int64_t t1 = whisper_full_get_segment_t1(gf->whisper_context, n_segment);
-
-		float sentence_p = 0.0f;
-		const int n_tokens = whisper_full_n_tokens(gf->whisper_context, n_segment);
-		for (int j = 0; j < n_tokens; ++j) {
-			sentence_p += whisper_full_get_token_p(gf->whisper_context, n_segment, j);
+		if (packed.batch_size > 1) {
+			do_log(gf->log_level, "%s with %d segments of other filters",
+			       mode == PACK_MIX ? "mixed" : "packed", packed.batch_size - 1);
 		}
-		sentence_p /= (float)n_tokens;
 
-		// convert text to lowercase
-		std::string text_lower(text);
-		std::transform(text_lower.begin(), text_lower.end(), text_lower.begin(), ::tolower);
-		// trim whitespace (use lambda)
-		text_lower.erase(std::find_if(text_lower.rbegin(), text_lower.rend(),
-					      [](unsigned char ch) { return !std::isspace(ch); })
-					 .base(),
-				 text_lower.end());
+		const char *text = packed.text.c_str();
+		int64_t t0 = packed.t0;
+		int64_t t1 = packed.t1;
+		const float sentence_p = packed.p;
+		if (!slot.compressed_positions.empty()) {
+			// token times are in 10 ms, 160 samples
+			const size_t frames_10ms = WHISPER_SAMPLE_RATE / 100;
+			t0 = (int64_t)time_compress_source_frame(slot.compressed_positions,
+								 WHISPER_SAMPLE_RATE,
+								 (size_t)t0 * frames_10ms) /
+			     (int64_t)frames_10ms;
+			t1 = (int64_t)time_compress_source_frame(slot.compressed_positions,
+								 WHISPER_SAMPLE_RATE,
+								 (size_t)t1 * frames_10ms) /
+			     (int64_t)frames_10ms;
+		}
+
+		text_lower = normalize_text(text);
 
 		if (gf->log_words) {
 			info("[%s --> %s] (%.3f) %s", to_timestamp(t0).c_str(),
 			     to_timestamp(t1).c_str(), sentence_p, text_lower.c_str());
 		}
 
-		if (text_lower.empty()) {
-			return DETECTION_RESULT_SILENCE;
-		}
+		return detect_text(gf, text_lower, &matched);
+	}
+}
 
-		// use a regular expression to detect filler words with a word boundary
-		try {
-			if (gf->detect_regex != nullptr && strlen(gf->detect_regex) > 0) {
-				std::regex filler_regex(gf->detect_regex);
-				if (std::regex_search(text_lower, filler_regex,
-						      std::regex_constants::match_any)) {
-					return DETECTION_RESULT_FILLER;
-				}
-			}
-			if (gf->beep_regex != nullptr && strlen(gf->beep_regex) > 0) {
-				std::regex beep_regex(gf->beep_regex);
-				if (std::regex_search(text_lower, beep_regex,
-						      std::regex_constants::match_any)) {
-					return DETECTION_RESULT_BEEP;
-				}
-			}
-		} catch (const std::regex_error &e) {
-			error("Regex error: %s", e.what());
+void schedule_shadow_job(struct cleanstream_data *gf, std::shared_ptr<shadow_segment> segment);
+
+// Drop the oldest queued packets in analysis only mode when the analysis fell behind, so the
+// next window is recent audio. Called with whisper_buf_mutex held.
+void skip_analysis_backlog(struct cleanstream_data *gf)
+{
+	const size_t max_frames = TAP_MAX_BACKLOG_MSEC * gf->sample_rate / 1000;
+	const size_t queued_frames = gf->input_buffers[0].size / sizeof(float);
+	if (queued_frames <= max_frames) {
+		return;
+	}
+	// whole packets, the infos have to stay in line with the audio; a window is left
+	size_t skipped_frames = 0;
+	struct cleanstream_audio_info info;
+	while (gf->info_buffer.size >= sizeof(info)) {
+		circlebuf_peek_front(&gf->info_buffer, &info, sizeof(info));
+		if (queued_frames - skipped_frames - info.frames < gf->frames) {
+			break;
 		}
+		circlebuf_pop_front(&gf->info_buffer, nullptr, sizeof(info));
+		skipped_frames += info.frames;
 	}
-
-	return DETECTION_RESULT_SPEECH;
+	for (size_t c = 0; c < gf->channels; c++) {
+		circlebuf_pop_front(&gf->input_buffers[c], nullptr, skipped_frames * sizeof(float));
+	}
+	// the overlap of the last window is not next to the remaining audio
+	gf->last_num_frames = 0;
+	do_log(gf->log_level, "analysis behind by %d ms, skipped %d ms",
+	       (int)(queued_frames * 1000 / gf->sample_rate),
+	       (int)(skipped_frames * 1000 / gf->sample_rate));
+	session_stats_add_skipped(gf->stats, (double)skipped_frames / gf->sample_rate);
 }
 
-void process_audio_from_buffer(struct cleanstream_data *gf)
+// Analyze the next window on the slot and output it after the windows taken before it.
+// Returns false if the input buffer does not hold a full window yet.
+bool process_audio_from_buffer(struct cleanstream_data *gf, struct analysis_slot &slot,
+			       uint32_t dispatch_us)
 {
+	const size_t segment_size = gf->frames * sizeof(float);
 	uint32_t num_new_frames_from_infos = 0;
 	uint64_t start_timestamp = 0;
+	uint64_t generation = 0;
+	uint64_t sequence = 0;
+	size_t window_frames = 0;
+	size_t overlap_ms = 0;
+	const bool tap_mode = gf->tap_mode;
 
 	{
 		// scoped lock the buffer mutex
 		std::lock_guard<std::mutex> lock(whisper_buf_mutex);
+		if (gf->input_buffers[0].size < segment_size) {
+			return false;
+		}
+		do_log(gf->log_level,
+		       "found %lu bytes, %lu frames in input buffer, need >= %lu, processing",
+		       gf->input_buffers[0].size, (size_t)(gf->input_buffers[0].size / sizeof(float)),
+		       segment_size);
+		if (tap_mode) {
+			skip_analysis_backlog(gf);
+		}
+		generation = gf->buffer_generation;
+		sequence = gf->next_window_sequence++;
+		overlap_ms = gf->overlap_ms;
 
 		// We need (gf->frames - gf->overlap_frames) new frames to run inference,
 		// except for the first segment, where we need the whole gf->frames frames
@@ -400,7 +668,6 @@ void process_audio_from_buffer(struct cleanstream_data *gf)
 		if (gf->last_num_frames == 0) {
 			how_many_frames_needed = gf->frames;
 		}
-
 		// pop infos from the info buffer and mark the beginning timestamp from the first
 		// info as the beginning timestamp of the segment
 		struct cleanstream_audio_info info_from_buf = {0};
@@ -450,65 +717,126 @@ void process_audio_from_buffer(struct cleanstream_data *gf)
 		} else {
 			gf->last_num_frames = num_new_frames_from_infos;
 		}
+
+		// the next window overwrites copy_buffers while this one is analyzed
+		window_frames = gf->last_num_frames;
+		for (size_t c = 0; c < gf->channels; c++) {
+			slot.window[c].assign(gf->copy_buffers[c], gf->copy_buffers[c] + window_frames);
+		}
 	}
 
-	do_log(gf->log_level, "processing %d frames (%d ms), start timestamp %" PRIu64 " ",
-	       (int)gf->last_num_frames, (int)(gf->last_num_frames * 1000 / gf->sample_rate),
+	do_log(gf->log_level,
+	       "processing window %" PRIu64 ": %d frames (%d ms), start timestamp %" PRIu64 " ",
+	       sequence, (int)window_frames, (int)(window_frames * 1000 / gf->sample_rate),
 	       start_timestamp);
+	CLEANSTREAM_TRACE2(segment_pop, num_new_frames_from_infos, start_timestamp);
 
 	// time the audio processing
 	auto start = std::chrono::high_resolution_clock::now();
-
-	// resample to 16kHz
-	float *output[MAX_PREPROC_CHANNELS];
-	uint32_t out_frames;
-	uint64_t ts_offset;
-	audio_resampler_resample(gf->resampler, (uint8_t **)output, &out_frames, &ts_offset,
-				 (const uint8_t **)gf->copy_buffers, (uint32_t)gf->last_num_frames);
-
-	do_log(gf->log_level, "%d channels, %d frames, %f ms", (int)gf->channels, (int)out_frames,
-	       (float)out_frames / WHISPER_SAMPLE_RATE * 1000.0f);
-
-	bool skipped_inference = false;
-
-	if (gf->vad_enabled) {
-		skipped_inference = !::vad_simple(output[0], out_frames, WHISPER_SAMPLE_RATE,
-						  VAD_THOLD, FREQ_THOLD,
-						  gf->log_level != LOG_DEBUG);
-	}
-
-	// copy output buffer before potentially modifying it
+	const uint64_t start_cpu_ns = process_cpu_time_ns();
+	flight_record record = {};
+	record.audio_timestamp = start_timestamp;
+	record.frames = num_new_frames_from_infos;
+	record.overlap_ms = (uint32_t)overlap_ms;
+	record.dispatch_us = dispatch_us;
+	flight_record_set_string(record.decision, sizeof(record.decision), "vad");
+	session_segment stats_segment;
+	uint64_t stage_ns = os_gettime_ns();
+
+	// the window starts with the overlap before the new frames
+	const uint64_t window_timestamp =
+		start_timestamp - (uint64_t)(window_frames - num_new_frames_from_infos) *
+					  1000000000ULL / gf->sample_rate;
+
+	// analyze the mix, or each channel on its own with per-channel analysis
+	const bool per_channel = gf->per_channel && gf->channels > 1;
+	const size_t n_analyzed =
+		per_channel ? std::min(gf->channels, (size_t)MAX_ANALYZED_CHANNELS) : 1;
 	for (size_t c = 0; c < gf->channels; c++) {
-		da_copy_array(gf->copy_output_buffers[c], gf->copy_buffers[c], gf->last_num_frames);
+		slot.output[c] = slot.window[c];
 	}
 
-	if (!skipped_inference) {
-		// run inference
-		const int inference_result = run_whisper_inference(gf, output[0], out_frames);
-
-		if (inference_result == DETECTION_RESULT_FILLER) {
-			// this is a filler segment, reduce the output volume
-
-			// find first word boundary, up to 50% of the way through the segment
-			// const size_t first_boundary = word_boundary_simple(gf->copy_buffers[0], num_new_frames_from_infos,
-			//                                                    num_new_frames_from_infos / 2,
-			//                                                    gf->sample_rate, 0.1f, true);
-			const size_t first_boundary = 0;
+	bool skipped_inference = true;
+	// results of the analyzed channels, silence when the VAD skipped them
+	int results[MAX_ANALYZED_CHANNELS];
+	std::string matches[MAX_ANALYZED_CHANNELS];
+	std::string texts;
+	for (size_t a = 0; a < n_analyzed; a++) {
+		results[a] = DETECTION_RESULT_SILENCE;
+
+		// resample to 16kHz
+		const float *window[MAX_AUDIO_CHANNELS];
+		audio_resampler_t *resampler = slot.resampler;
+		if (per_channel) {
+			window[0] = slot.window[a].data();
+			resampler = slot.channel_resamplers[a];
+		} else {
+			for (size_t c = 0; c < gf->channels; c++) {
+				window[c] = slot.window[c].data();
+			}
+		}
+		stage_ns = os_gettime_ns();
+		float *output[MAX_AUDIO_CHANNELS];
+		uint32_t out_frames;
+		uint64_t ts_offset;
+		audio_resampler_resample(resampler, (uint8_t **)output, &out_frames, &ts_offset,
+					 (const uint8_t **)window, (uint32_t)window_frames);
+		const uint64_t resample_ns = os_gettime_ns() - stage_ns;
+		record.resample_us += (uint32_t)(resample_ns / 1000);
+		CLEANSTREAM_TRACE2(resample, out_frames, resample_ns);
+		stage_ns = os_gettime_ns();
+
+		do_log(gf->log_level, "%d channels, %d frames, %f ms", (int)gf->channels,
+		       (int)out_frames, (float)out_frames / WHISPER_SAMPLE_RATE * 1000.0f);
+
+		bool voiced = true;
+		float energy = 0.0f;
+		if (gf->vad_enabled) {
+			voiced = ::vad_simple(output[0], out_frames, WHISPER_SAMPLE_RATE, VAD_THOLD,
+					      FREQ_THOLD, &energy);
+			if (gf->log_level != LOG_DEBUG) {
+				info("vad energy: %f, vad_thold: %f, freq_thold: %f", energy,
+				     VAD_THOLD, FREQ_THOLD);
+			}
+		}
+		const uint64_t vad_ns = os_gettime_ns() - stage_ns;
+		record.vad_us += (uint32_t)(vad_ns / 1000);
+		CLEANSTREAM_TRACE3(vad, voiced, (int64_t)(energy * 1e6f), vad_ns);
 
+		if (!voiced) {
 			if (gf->log_words) {
-				info("filler segment, reducing volume on frames %lu -> %u",
-				     first_boundary, num_new_frames_from_infos);
+				info("skipping inference");
 			}
+			continue;
+		}
+		skipped_inference = false;
 
-			if (gf->do_silence) {
-				for (size_t c = 0; c < gf->channels; c++) {
-					for (size_t i = first_boundary;
-					     i < num_new_frames_from_infos; i++) {
-						gf->copy_output_buffers[c].array[i] = 0;
-					}
-				}
-			}
-		} else if (inference_result == DETECTION_RESULT_BEEP) {
+		// run inference
+		std::string text;
+		const uint64_t inference_start_ns = os_gettime_ns();
+		CLEANSTREAM_TRACE1(inference_begin, out_frames);
+		results[a] = run_whisper_inference(gf, slot, a, output[0], out_frames,
+						   window_timestamp, text, matches[a]);
+		const uint64_t inference_ns = os_gettime_ns() - inference_start_ns;
+		record.inference_us += (uint32_t)(inference_ns / 1000);
+		CLEANSTREAM_TRACE2(inference_end, results[a], inference_ns);
+		CLEANSTREAM_TRACE3(detection, results[a], text.c_str(), matches[a].c_str());
+		texts += (texts.empty() ? "" : " | ") + text;
+		stats_segment.decisions.push_back(detection_result_name(results[a]));
+		if (!matches[a].empty()) {
+			stats_segment.detections.push_back(matches[a]);
+		}
+
+		if (gf->shadow.enabled && results[a] != DETECTION_RESULT_UNKNOWN) {
+			auto segment = std::make_shared<shadow_segment>();
+			segment->pcm.assign(output[0], output[0] + out_frames);
+			segment->live_result = results[a];
+			segment->live_text = text;
+			segment->live_ns = inference_ns;
+			schedule_shadow_job(gf, segment);
+		}
+
+		if (results[a] == DETECTION_RESULT_BEEP && !tap_mode) {
 			const size_t first_boundary = 0;
 
 			if (gf->log_words) {
@@ -517,10 +845,13 @@ void process_audio_from_buffer(struct cleanstream_data *gf)
 			}
 			if (gf->do_silence) {
 				for (size_t c = 0; c < gf->channels; c++) {
+					if (per_channel && c != a) {
+						continue;
+					}
 					for (size_t i = first_boundary;
 					     i < num_new_frames_from_infos; i++) {
 						// add a beep at A4 (440Hz)
-						gf->copy_output_buffers[c].array[i] =
+						slot.output[c][i] =
 							0.5f *
 							sinf(2.0f * (float)M_PI * 440.0f *
 							     (float)i / (float)gf->sample_rate);
@@ -528,48 +859,226 @@ void process_audio_from_buffer(struct cleanstream_data *gf)
 				}
 			}
 		}
-	} else {
-		if (gf->log_words) {
-			info("skipping inference");
+	}
+
+	// the segment's result is the strongest of the channels: beep, filler, speech, silence
+	size_t strongest = 0;
+	for (size_t a = 1; a < n_analyzed; a++) {
+		if (results[a] > results[strongest]) {
+			strongest = a;
 		}
 	}
+	const int inference_result = results[strongest];
+	const std::string &matched = matches[strongest];
+	stats_segment.vad_skipped = skipped_inference;
+	if (!skipped_inference) {
+		flight_record_set_string(record.decision, sizeof(record.decision),
+					 detection_result_name(inference_result));
+		flight_record_set_string(record.text, sizeof(record.text), texts.c_str());
+	}
+
+	// end of timer, the wait for earlier windows below is not part of the processing
+	auto end = std::chrono::high_resolution_clock::now();
+	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+	const uint32_t new_frames_from_infos_ms =
+		num_new_frames_from_infos * 1000 /
+		gf->sample_rate; // number of frames in this packet
+	do_log(gf->log_level, "audio processing of %u ms new data took %d ms",
+	       new_frames_from_infos_ms, (int)duration);
 
 	{
+		std::unique_lock<std::mutex> lock(gf->commit_mutex);
+		gf->commit_cv.wait(lock,
+				   [gf, sequence] { return gf->next_commit_sequence == sequence; });
+	}
+
+	/* from here on windows run one at a time, in the order they were taken */
+
+	// channels with a filler, all of them when the mix was analyzed. A cut removes the time
+	// from every channel, so the channels without a filler have to be quiet. Channels past
+	// the analyzed ones of per-channel analysis are not known to be quiet.
+	bool filler_channels[MAX_AUDIO_CHANNELS] = {};
+	bool has_filler = false;
+	bool others_quiet = true;
+	for (size_t c = 0; c < gf->channels; c++) {
+		const int result = !per_channel     ? results[0]
+				   : c < n_analyzed ? results[c]
+						    : DETECTION_RESULT_UNKNOWN;
+		filler_channels[c] = result == DETECTION_RESULT_FILLER;
+		has_filler = has_filler || filler_channels[c];
+		others_quiet = others_quiet &&
+			       (filler_channels[c] || result == DETECTION_RESULT_SILENCE);
+	}
+
+	// frames of the slot output to output, fewer if a filler was cut
+	size_t segment_frames = num_new_frames_from_infos;
+	bool cut = false;
+	if (has_filler && !tap_mode) {
+		// this is a filler segment, reduce the output volume
+
+		// find first word boundary, up to 50% of the way through the segment
+		// const size_t first_boundary = word_boundary_simple(gf->copy_buffers[0], num_new_frames_from_infos,
+		//                                                    num_new_frames_from_infos / 2,
+		//                                                    gf->sample_rate, 0.1f, true);
+		const size_t first_boundary = 0;
+
+		if (gf->delay.cut_enabled && others_quiet) {
+			size_t queued_frames;
+			{
+				std::lock_guard<std::mutex> lock(whisper_outbuf_mutex);
+				queued_frames = gf->output_buffers[0].size / sizeof(float);
+			}
+			cut = delay_line_try_cut(gf->delay,
+						 num_new_frames_from_infos - first_boundary,
+						 queued_frames, num_new_frames_from_infos, duration,
+						 gf->sample_rate);
+		}
+		if (cut) {
+			// the audio after the boundary is dropped, the next segment is crossfaded
+			// with what was output before it
+			segment_frames = first_boundary;
+			stats_segment.cut = true;
+			if (gf->log_words) {
+				info("filler segment, cut frames %lu -> %u, %d ms recovered",
+				     first_boundary, num_new_frames_from_infos,
+				     (int)((num_new_frames_from_infos - segment_frames) * 1000 /
+					   gf->sample_rate));
+			}
+		} else {
+			if (gf->log_words) {
+				info("filler segment, reducing volume on frames %lu -> %u",
+				     first_boundary, num_new_frames_from_infos);
+			}
+
+			if (gf->do_silence) {
+				for (size_t c = 0; c < gf->channels; c++) {
+					if (!filler_channels[c]) {
+						continue;
+					}
+					for (size_t i = first_boundary; i < num_new_frames_from_infos;
+					     i++) {
+						slot.output[c][i] = 0;
+					}
+				}
+			}
+		}
+	}
+
+	// shorten the segment while the delay line holds more than the catch-up target
+	float *segment_out[MAX_AUDIO_CHANNELS];
+	for (size_t c = 0; c < gf->channels; c++) {
+		segment_out[c] = slot.output[c].data();
+	}
+	size_t segment_out_frames = segment_frames;
+	const double speed = tap_mode || segment_frames == 0
+				     ? 1.0
+				     : delay_line_catchup_speed(gf->delay, gf->added_latency_ns,
+								segment_frames, gf->sample_rate);
+	if (speed > 1.0) {
+		segment_out_frames = delay_line_shorten(gf->delay, segment_out, gf->channels,
+							segment_frames, speed, gf->sample_rate);
+		do_log(gf->log_level, "catch-up: played %.1f%% faster, %d ms recovered",
+		       (speed - 1.0) * 100.0,
+		       (int)((segment_frames - segment_out_frames) * 1000 / gf->sample_rate));
+		stats_segment.catchup = true;
+	}
+
+	if (tap_mode) {
+		// the audio went out unchanged when it came in, only the detections are kept
+		if (inference_result == DETECTION_RESULT_FILLER ||
+		    inference_result == DETECTION_RESULT_BEEP) {
+			session_stats_add_event(
+				gf->stats, start_timestamp,
+				(uint64_t)num_new_frames_from_infos * 1000000000ULL / gf->sample_rate,
+				detection_result_name(inference_result), matched);
+		}
+	} else if (generation != gf->buffer_generation) {
+		// the buffers were reset while the segment was processed
+		stats_segment.dropped = true;
+	} else {
 		std::lock_guard<std::mutex> lock(whisper_outbuf_mutex);
 
-		struct cleanstream_audio_info info_out = {0};
-		info_out.frames = num_new_frames_from_infos; // number of frames in this packet
-		info_out.timestamp = start_timestamp;        // timestamp of this packet
-		circlebuf_push_back(&gf->info_out_buffer, &info_out, sizeof(info_out));
+		const size_t faded_frames =
+			delay_line_crossfade_cut(gf->delay, gf->output_buffers, gf->channels,
+						 segment_out, segment_out_frames, gf->sample_rate);
+		if (cut) {
+			delay_line_queue_cut(gf->delay, num_new_frames_from_infos - segment_frames,
+					     gf->sample_rate);
+		}
 
-		for (size_t c = 0; c < gf->channels; c++) {
-			circlebuf_push_back(&gf->output_buffers[c],
-					    gf->copy_output_buffers[c].array,
-					    (num_new_frames_from_infos) * sizeof(float));
+		struct cleanstream_audio_info info_out = {0};
+		// number of frames in this packet
+		info_out.frames = (uint32_t)(segment_out_frames - faded_frames);
+		info_out.timestamp = start_timestamp; // timestamp of this packet
+		info_out.source_frames = num_new_frames_from_infos;
+		if (info_out.frames > 0) {
+			circlebuf_push_back(&gf->info_out_buffer, &info_out, sizeof(info_out));
+			for (size_t c = 0; c < gf->channels; c++) {
+				circlebuf_push_back(&gf->output_buffers[c],
+						    segment_out[c] + faded_frames,
+						    info_out.frames * sizeof(float));
+			}
 		}
 		// log sizes of output buffers
 		do_log(gf->log_level,
 		       "output info buffer size: %lu, output data buffer size bytes: %lu",
 		       gf->info_out_buffer.size / sizeof(struct cleanstream_audio_info),
 		       gf->output_buffers[0].size);
+		record.output_queue_ms =
+			(uint32_t)(gf->output_buffers[0].size / sizeof(float) * 1000 /
+				   gf->sample_rate);
 	}
 
-	// end of timer
-	auto end = std::chrono::high_resolution_clock::now();
-	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-	const uint32_t new_frames_from_infos_ms =
-		num_new_frames_from_infos * 1000 /
-		gf->sample_rate; // number of frames in this packet
-	do_log(gf->log_level, "audio processing of %u ms new data took %d ms",
-	       new_frames_from_infos_ms, (int)duration);
+	{
+		std::lock_guard<std::mutex> lock(whisper_buf_mutex);
+		record.input_queue_ms = (uint32_t)(gf->input_buffers[0].size / sizeof(float) *
+						   1000 / gf->sample_rate);
+	}
+	record.added_latency_ms = (uint32_t)(gf->added_latency_ns / 1000000);
+	record.total_us = (uint32_t)(
+		std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+	record.wall_ns = os_gettime_ns();
+	flight_recorder_add(gf->recorder, record);
+	stats_segment.audio_sec = (double)new_frames_from_infos_ms / 1000.0;
+	stats_segment.wall_ns = (uint64_t)record.total_us * 1000;
+	stats_segment.cpu_ns = process_cpu_time_ns() - start_cpu_ns;
+	stats_segment.added_latency_ns = gf->added_latency_ns;
+
+	// have the housekeeping dump the recorder when this segment crosses a threshold
+	const uint32_t latency_threshold_ms = gf->recorder_latency_ms;
+	const uint32_t inference_threshold_ms = gf->recorder_inference_ms;
+	const char *dump_reason = nullptr;
+	if (latency_threshold_ms > 0 && record.added_latency_ms > latency_threshold_ms) {
+		dump_reason = "added latency threshold";
+	} else if (inference_threshold_ms > 0 &&
+		   record.inference_us / 1000 > inference_threshold_ms) {
+		dump_reason = "inference time threshold";
+	}
+	if (dump_reason != nullptr &&
+	    record.wall_ns - gf->recorder_last_auto_dump_ns > FLIGHT_RECORDER_DUMP_COOLDOWN_NS) {
+		gf->recorder_last_auto_dump_ns = record.wall_ns;
+		gf->recorder_dump_reason = dump_reason;
+	}
 
-	if (duration > new_frames_from_infos_ms) {
+	{
+		std::lock_guard<std::mutex> lock(gf->commit_mutex);
+		gf->next_commit_sequence++;
+	}
+	gf->commit_cv.notify_all();
+
+	// with concurrent windows a window can take as many hops as there are windows in
+	// flight before the analysis falls behind
+	const int64_t budget_ms = (int64_t)new_frames_from_infos_ms * gf->parallel_windows;
+	std::lock_guard<std::mutex> lock(whisper_buf_mutex);
+	const size_t old_overlap_ms = gf->overlap_ms;
+	if (duration > budget_ms) {
 		// try to decrease overlap down to minimum of 100 ms
 		gf->overlap_ms = std::max((uint64_t)gf->overlap_ms - 10, (uint64_t)100);
 		gf->overlap_frames = gf->overlap_ms * gf->sample_rate / 1000;
 		do_log(gf->log_level,
 		       "audio processing took too long (%d ms), reducing overlap to %lu ms",
 		       (int)duration, gf->overlap_ms);
+		stats_segment.overlap_change = -1;
 	} else if (!skipped_inference) {
 		// try to increase overlap up to 75% of the segment
 		gf->overlap_ms = std::min((uint64_t)gf->overlap_ms + 10,
@@ -577,51 +1086,517 @@ void process_audio_from_buffer(struct cleanstream_data *gf)
 		gf->overlap_frames = gf->overlap_ms * gf->sample_rate / 1000;
 		do_log(gf->log_level, "audio processing took %d ms, increasing overlap to %lu ms",
 		       (int)duration, gf->overlap_ms);
+		stats_segment.overlap_change = 1;
+	}
+	if (gf->overlap_ms != old_overlap_ms) {
+		CLEANSTREAM_TRACE2(overlap_change, old_overlap_ms, gf->overlap_ms);
 	}
+	session_stats_add_segment(gf->stats, stats_segment);
+	return true;
 }
 
-void whisper_loop(void *data)
+void reset_audio_buffers(struct cleanstream_data *gf)
 {
-	struct cleanstream_data *gf = static_cast<struct cleanstream_data *>(data);
-	const size_t segment_size = gf->frames * sizeof(float);
+	{
+		std::lock_guard<std::mutex> lock(whisper_buf_mutex);
+		circlebuf_pop_front(&gf->info_buffer, nullptr, gf->info_buffer.size);
+		for (size_t c = 0; c < gf->channels; c++) {
+			circlebuf_pop_front(&gf->input_buffers[c], nullptr,
+					    gf->input_buffers[c].size);
+		}
+		gf->last_num_frames = 0;
+		gf->buffer_generation++;
+	}
+	{
+		std::lock_guard<std::mutex> lock(whisper_outbuf_mutex);
+		circlebuf_pop_front(&gf->info_out_buffer, nullptr, gf->info_out_buffer.size);
+		for (size_t c = 0; c < gf->channels; c++) {
+			circlebuf_pop_front(&gf->output_buffers[c], nullptr,
+					    gf->output_buffers[c].size);
+		}
+		delay_line_reset(gf->delay);
+	}
+}
 
-	info("starting whisper thread");
+// Load the model if the filter asked for it, returns true when a whisper context is ready
+bool load_model_on_demand(struct cleanstream_data *gf)
+{
+	std::string model_path;
+	int n_threads;
+	{
+		std::lock_guard<std::mutex> lock(whisper_ctx_mutex);
+		if (gf->whisper_context != nullptr) {
+			return true;
+		}
+		if (!gf->model_requested || gf->model_load_failed) {
+			return false;
+		}
+		model_path = gf->whisper_model_path;
+		n_threads = gf->whisper_params.n_threads;
+	}
 
-	// Thread main loop
-	while (true) {
-		{
-			std::lock_guard<std::mutex> lock(whisper_ctx_mutex);
-			if (gf->whisper_context == nullptr) {
-				warn("Whisper context is null, exiting thread");
-				break;
+	const std::string model_file = find_model_file(model_path);
+	if (model_file.empty()) {
+		error("Whisper model %s does not exist", model_path.c_str());
+		gf->model_load_failed = true;
+		return false;
+	}
+
+	// load outside the lock, this takes a while for the larger models unless another
+	// filter already loaded the same file
+	const uint64_t start_ns = os_gettime_ns();
+	std::shared_ptr<struct whisper_context> ctx = acquire_whisper_model(model_file);
+	struct whisper_state *state = ctx ? whisper_init_state(ctx.get()) : nullptr;
+	if (state == nullptr) {
+		error("Failed to load whisper model %s", model_file.c_str());
+		gf->model_load_failed = true;
+		return false;
+	}
+	// the model list shows how fast the model runs here
+	calibrate_whisper_model(model_path, ctx.get(), state, n_threads);
+
+	std::lock_guard<std::mutex> lock(whisper_ctx_mutex);
+	if (model_path != gf->whisper_model_path) {
+		// the model was changed while loading, the next job loads the new one
+		whisper_free_state(state);
+		return false;
+	}
+	if (gf->whisper_context != nullptr) {
+		// the job of a concurrent window loaded it first
+		whisper_free_state(state);
+		return true;
+	}
+	gf->whisper_context = ctx;
+	{
+		// the state goes to the first slot, the other slots create theirs when used
+		std::lock_guard<std::mutex> slot_lock(gf->slots[0].mutex);
+		free_slot_state(gf->slots[0]);
+		gf->slots[0].ctx = ctx;
+		gf->slots[0].states[0] = state;
+	}
+	gf->model_loaded = true;
+	info("loaded whisper model %s in %d ms, %s", model_file.c_str(),
+	     (int)((os_gettime_ns() - start_ns) / 1000000), whisper_print_system_info());
+	return true;
+}
+
+// Free the model if no audio arrived for unload_idle_ms, it is reloaded on the next audio
+void unload_model_if_idle(struct cleanstream_data *gf)
+{
+	const uint64_t unload_idle_ms = gf->unload_idle_ms;
+	if (unload_idle_ms == 0) {
+		return;
+	}
+	const uint64_t idle_ms = (os_gettime_ns() - gf->last_audio_ns) / 1000000;
+	if (idle_ms < unload_idle_ms) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(whisper_ctx_mutex);
+		if (gf->whisper_context == nullptr) {
+			return;
+		}
+		release_whisper_model(gf);
+		gf->model_requested = false;
+	}
+	if (gf->shadow.enabled) {
+		schedule_shadow_job(gf, nullptr);
+	}
+	// drop the stale audio, the filter passes audio through until the model is back
+	reset_audio_buffers(gf);
+	info("no audio for %d ms, unloaded whisper model", (int)idle_ms);
+}
+
+// Apply the placement settings of the filter to the pool worker running its job,
+// whisper's compute threads inherit them
+void place_inference_thread(struct cleanstream_data *gf)
+{
+	// the placement last applied to this worker thread
+	thread_local bool placement_applied = false;
+	thread_local inference_thread_config applied_config;
+	thread_local inference_thread_placement applied_placement;
+
+	inference_thread_config config;
+	int n_threads;
+	{
+		std::lock_guard<std::mutex> lock(whisper_ctx_mutex);
+		config = gf->thread_config;
+		n_threads = gf->whisper_params.n_threads;
+	}
+
+	if (!placement_applied || config != applied_config) {
+		applied_placement = apply_inference_thread_placement(config);
+		applied_config = config;
+		placement_applied = true;
+		do_log(gf->log_level, "inference thread: cpu set '%s' (%d cpus), numa node %d",
+		       config.cpu_set.c_str(), applied_placement.n_cpus,
+		       applied_placement.numa_node);
+		if (applied_placement.n_cpus > 0 && n_threads > applied_placement.n_cpus) {
+			warn("n_threads (%d) is larger than the CPU set (%d cpus)", n_threads,
+			     applied_placement.n_cpus);
+		}
+	}
+
+	if (applied_placement.numa_node != gf->numa_node) {
+		gf->numa_node = applied_placement.numa_node;
+		// the weights and states were allocated on the previous node, reload them on the
+		// new one. Weights other filters still use are not reloaded until they let go.
+		std::lock_guard<std::mutex> lock(whisper_ctx_mutex);
+		if (gf->whisper_context == nullptr) {
+			return;
+		}
+		long own_references = 1;
+		for (struct analysis_slot &slot : gf->slots) {
+			std::lock_guard<std::mutex> slot_lock(slot.mutex);
+			own_references += slot.ctx == gf->whisper_context ? 1 : 0;
+		}
+		if (gf->whisper_context.use_count() > own_references) {
+			info("NUMA node changed to %d, the whisper model is shared with other filters "
+			     "and stays where it was loaded, only the states move",
+			     gf->numa_node);
+			for (struct analysis_slot &slot : gf->slots) {
+				std::lock_guard<std::mutex> slot_lock(slot.mutex);
+				free_slot_state(slot);
 			}
+		} else {
+			info("NUMA node changed to %d, reloading whisper model", gf->numa_node);
+			release_whisper_model(gf);
 		}
+	}
+}
+
+// Take a free analysis slot, there is one for every job that can run
+struct analysis_slot *acquire_analysis_slot(struct cleanstream_data *gf)
+{
+	std::lock_guard<std::mutex> lock(gf->slots_mutex);
+	for (struct analysis_slot &slot : gf->slots) {
+		if (!slot.busy) {
+			slot.busy = true;
+			return &slot;
+		}
+	}
+	return nullptr;
+}
+
+void release_analysis_slot(struct cleanstream_data *gf, struct analysis_slot *slot)
+{
+	if (slot - gf->slots >= gf->parallel_windows) {
+		// no longer needed after the number of concurrent windows was lowered
+		std::lock_guard<std::mutex> lock(slot->mutex);
+		free_slot_state(*slot);
+	}
+	std::lock_guard<std::mutex> lock(gf->slots_mutex);
+	slot->busy = false;
+}
+
+// Runs on an inference pool worker. With parallel_windows above 1 several jobs of the filter
+// run at once, each taking the next window as soon as its audio is in: windows start a hop
+// apart instead of after the previous inference.
+void whisper_job(struct cleanstream_data *gf, uint32_t dispatch_us)
+{
+	place_inference_thread(gf);
+	if (!load_model_on_demand(gf)) {
+		return;
+	}
+	unload_model_if_idle(gf);
+
+	struct analysis_slot *slot = acquire_analysis_slot(gf);
+	if (slot == nullptr) {
+		return;
+	}
+	// Process while we have enough data. This also removes the processed data from the
+	// input buffer, the mutex is locked inside process_audio_from_buffer.
+	while (!gf->stopping && process_audio_from_buffer(gf, *slot, dispatch_us)) {
+	}
+	release_analysis_slot(gf, slot);
+}
 
-		// Check if we have enough data to process
-		while (true) {
-			size_t input_buf_size = 0;
+// Queue the shadow job of the filter at the lowest priority. Without a segment it releases
+// the shadow model.
+void schedule_shadow_job(struct cleanstream_data *gf, std::shared_ptr<shadow_segment> segment)
+{
+	if (gf->stopping || !shadow_runner_begin(gf->shadow, segment != nullptr)) {
+		return;
+	}
+	const int n_threads = shadow_runner_threads(gf->shadow);
+	inference_pool_submit(INFERENCE_PRIORITY_LOWEST, n_threads, [gf, segment](bool cancelled) {
+		if (!cancelled) {
+			whisper_full_params params;
 			{
-				std::lock_guard<std::mutex> lock(whisper_buf_mutex);
-				input_buf_size = gf->input_buffers[0].size;
+				std::lock_guard<std::mutex> lock(whisper_ctx_mutex);
+				params = gf->whisper_params;
 			}
+			auto classify = [gf](const std::string &text) {
+				return detect_text(gf, text);
+			};
+			shadow_runner_run(gf->shadow, segment.get(), params, classify,
+					  obs_source_get_name(gf->context));
+		}
 
-			if (input_buf_size >= segment_size) {
-				do_log(gf->log_level,
-				       "found %lu bytes, %lu frames in input buffer, need >= %lu, processing",
-				       input_buf_size, (size_t)(input_buf_size / sizeof(float)),
-				       segment_size);
+		// gf must not be touched after the lock is released, destroy may be waiting
+		std::lock_guard<std::mutex> lock(gf->job_mutex);
+		gf->shadow.pending = false;
+		gf->job_cv.notify_all();
+	});
+}
 
-				// Process the audio. This will also remove the processed data from the input buffer.
-				// Mutex is locked inside process_audio_from_buffer.
-				process_audio_from_buffer(gf);
-			} else {
-				break;
-			}
+// Queue a job for the filter on the inference pool unless parallel_windows jobs are
+// already pending
+void schedule_whisper_job(struct cleanstream_data *gf)
+{
+	if (gf->stopping) {
+		return;
+	}
+	int running = gf->jobs_running;
+	do {
+		if (running >= gf->parallel_windows) {
+			return;
+		}
+	} while (!gf->jobs_running.compare_exchange_weak(running, running + 1));
+
+	const int n_threads = gf->job_threads;
+	const uint64_t submit_ns = os_gettime_ns();
+	inference_pool_submit(gf->inference_priority, n_threads, [gf, submit_ns](bool cancelled) {
+		if (!cancelled) {
+			const uint32_t dispatch_us =
+				(uint32_t)((os_gettime_ns() - submit_ns) / 1000);
+			do_log(gf->log_level, "whisper job dispatched after %d us",
+			       (int)dispatch_us);
+			whisper_job(gf, dispatch_us);
+		}
+
+		// gf must not be touched after the lock is released, destroy may be waiting
+		std::lock_guard<std::mutex> lock(gf->job_mutex);
+		gf->jobs_running--;
+		gf->job_cv.notify_all();
+	});
+}
+
+// Map the lexicon file, or the new file after it was replaced. A failed load keeps the
+// current lexicon.
+void refresh_lexicon(struct cleanstream_data *gf)
+{
+	std::string path;
+	std::shared_ptr<const lexicon> current;
+	{
+		std::lock_guard<std::mutex> lock(gf->lexicon_mutex);
+		path = gf->lexicon_path;
+		current = gf->lexicon;
+	}
+	if (path.empty()) {
+		return;
+	}
+
+	std::string load_error;
+	std::shared_ptr<const lexicon> loaded = lexicon_load(path, load_error);
+	if (loaded == nullptr) {
+		if (!gf->lexicon_failed.exchange(true)) {
+			error("Failed to load lexicon %s: %s", path.c_str(), load_error.c_str());
+		}
+		return;
+	}
+	gf->lexicon_failed = false;
+	if (loaded == current) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(gf->lexicon_mutex);
+		if (gf->lexicon_path != path) {
+			// changed in the meantime, the update loaded the new one
+			return;
+		}
+		gf->lexicon = loaded;
+	}
+	info("loaded lexicon %s, %u phrases", path.c_str(), lexicon_entry_count(*loaded));
+}
+
+// Called about once a second from the inference pool
+void whisper_housekeeping(struct cleanstream_data *gf)
+{
+	refresh_lexicon(gf);
+
+	const uint64_t unload_idle_ms = gf->unload_idle_ms;
+	if (gf->model_loaded && unload_idle_ms > 0 &&
+	    (os_gettime_ns() - gf->last_audio_ns) / 1000000 >= unload_idle_ms) {
+		// the job unloads the model
+		schedule_whisper_job(gf);
+	}
+
+	const char *dump_reason = gf->recorder_dump_reason.exchange(nullptr);
+	if (dump_reason != nullptr) {
+		flight_recorder_dump(gf->recorder, obs_source_get_name(gf->context), dump_reason);
+	}
+
+	const char *report_reason = gf->report_reason.exchange(nullptr);
+	if (report_reason != nullptr) {
+		session_report_write(gf->stats, obs_source_get_name(gf->context), report_reason);
+	}
+}
+
+// Have the housekeeping write a session report when the output stops
+void cleanstream_frontend_event(enum obs_frontend_event event, void *data)
+{
+	struct cleanstream_data *gf = static_cast<struct cleanstream_data *>(data);
+	if (event == OBS_FRONTEND_EVENT_STREAMING_STOPPED) {
+		gf->report_reason = "streaming stopped";
+	} else if (event == OBS_FRONTEND_EVENT_RECORDING_STOPPED) {
+		gf->report_reason = "recording stopped";
+	}
+}
+
+// Delay line output for catch-up and cut mode, which change the length of the audio
+struct obs_audio_data *output_delay_line_audio(struct cleanstream_data *gf,
+					       struct obs_audio_data *audio)
+{
+	const uint32_t frames = audio->frames;
+	const uint64_t target_ns = gf->delay.target_ns;
+	const uint64_t input_end_ts =
+		audio->timestamp + (uint64_t)frames * 1000000000ULL / gf->sample_rate;
+
+	da_resize(gf->output_data, frames * gf->channels);
+	for (size_t c = 0; c < gf->channels; c++) {
+		gf->output_audio.data[c] = (uint8_t *)&gf->output_data.array[c * frames];
+	}
+
+	delay_line_playback playback;
+	{
+		std::lock_guard<std::mutex> lock(whisper_outbuf_mutex);
+		playback = delay_line_play(gf->delay, &gf->info_out_buffer, gf->output_buffers,
+					   gf->channels, gf->sample_rate, input_end_ts, frames,
+					   gf->output_audio.data);
+	}
+	if (playback.primed) {
+		gf->added_latency_ns = playback.latency_ns;
+	}
+
+	if (playback.filled < frames) {
+		// priming or underrun, the latency grows and is recovered later
+		for (size_t c = 0; c < gf->channels; c++) {
+			memset(gf->output_audio.data[c] + playback.filled * sizeof(float), 0,
+			       (frames - playback.filled) * sizeof(float));
+		}
+		if (!playback.held && (playback.filled > 0 || playback.primed)) {
+			do_log(gf->log_level, "catch-up: underrun, %u frames of silence",
+			       frames - playback.filled);
+			gf->stats.underruns++;
+		}
+	}
+	if (playback.reset) {
+		// too far behind to catch up, e.g. after the source timestamps jumped
+		warn("catch-up: added latency %d ms, dropping the delay line",
+		     (int)(gf->added_latency_ns / 1000000));
+		reset_audio_buffers(gf);
+	}
+
+	gf->output_audio.frames = frames;
+	gf->output_audio.timestamp = audio->timestamp > target_ns ? audio->timestamp - target_ns
+								    : 0;
+	CLEANSTREAM_TRACE3(audio_out, frames, gf->output_audio.timestamp,
+			   (uint64_t)gf->added_latency_ns);
+	return &gf->output_audio;
+}
+
+// Pop the oldest packet of the queues into the output audio. Returns nullptr if there is none.
+struct obs_audio_data *output_packet(struct cleanstream_data *gf,
+				     const struct obs_audio_data *audio, struct circlebuf *info_buffer,
+				     struct circlebuf *buffers)
+{
+	if (info_buffer->size == 0) {
+		return nullptr;
+	}
+	struct cleanstream_audio_info info_out = {0};
+	circlebuf_pop_front(info_buffer, &info_out, sizeof(info_out));
+	do_log(gf->log_level,
+	       "output packet info: timestamp=%" PRIu64 ", frames=%" PRIu32 ", bytes=%lu, ms=%u",
+	       info_out.timestamp, info_out.frames, buffers[0].size,
+	       info_out.frames * 1000 / gf->sample_rate);
+
+	da_resize(gf->output_data, info_out.frames * gf->channels);
+	for (size_t c = 0; c < gf->channels; c++) {
+		gf->output_audio.data[c] = (uint8_t *)&gf->output_data.array[c * info_out.frames];
+		circlebuf_pop_front(&buffers[c], gf->output_audio.data[c],
+				    info_out.frames * sizeof(float));
+	}
+	gf->output_audio.frames = info_out.frames;
+	gf->output_audio.timestamp = info_out.timestamp;
+	gf->added_latency_ns = audio->timestamp > info_out.timestamp
+				       ? audio->timestamp - info_out.timestamp
+				       : 0;
+	CLEANSTREAM_TRACE3(audio_out, info_out.frames, info_out.timestamp,
+			   (uint64_t)gf->added_latency_ns);
+	return &gf->output_audio;
+}
+
+// Whether windows taken from the input buffer are still to be committed to the output
+bool windows_in_flight(struct cleanstream_data *gf)
+{
+	uint64_t taken;
+	{
+		std::lock_guard<std::mutex> lock(whisper_buf_mutex);
+		taken = gf->next_window_sequence;
+	}
+	std::lock_guard<std::mutex> lock(gf->commit_mutex);
+	return gf->next_commit_sequence != taken;
+}
+
+// Leave the silence pass-through. The pre-roll is silence, it goes to the output queue and
+// plays while the first segment of the new audio is analyzed. If analyzed audio is still to
+// be committed, so none of the pre-roll was output yet, it is analyzed ahead of the new audio.
+void end_silence(struct cleanstream_data *gf)
+{
+	if (!gf->silence.active) {
+		return;
+	}
+	if (windows_in_flight(gf)) {
+		std::lock_guard<std::mutex> lock(whisper_buf_mutex);
+		silence_passthrough_end(gf->silence, &gf->info_buffer, gf->input_buffers,
+					gf->channels);
+	} else {
+		std::lock_guard<std::mutex> lock(whisper_outbuf_mutex);
+		silence_passthrough_end(gf->silence, &gf->info_out_buffer, gf->output_buffers,
+					gf->channels);
+	}
+	do_log(gf->log_level, "signal returned, analyzing again");
+}
+
+// Pass digital silence through the pre-roll once it outlasts the delay of the filter. A
+// packet still goes out for every packet in, the analyzed audio first.
+// Returns false if the packet has to go through the filter as usual, otherwise out is set
+// to the audio to output.
+bool silence_fast_path(struct cleanstream_data *gf, struct obs_audio_data *audio,
+		       struct obs_audio_data **out)
+{
+	const uint64_t delay_ns = gf->added_latency_ns + BUFFER_SIZE_MSEC * 1000000ULL;
+	if (!silence_passthrough_detect(gf->silence, audio, gf->channels, gf->sample_rate,
+					delay_ns)) {
+		end_silence(gf);
+		return false;
+	}
+
+	if (!gf->silence.active) {
+		{
+			// the first window after the silence starts without overlap
+			std::lock_guard<std::mutex> lock(whisper_buf_mutex);
+			silence_passthrough_begin(gf->silence, &gf->info_buffer, gf->input_buffers,
+						  gf->channels);
+			gf->last_num_frames = 0;
 		}
-		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		do_log(gf->log_level, "digital silence, passing audio through");
 	}
+	gf->stats.silence_passthrough_ns +=
+		(uint64_t)audio->frames * 1000000000ULL / gf->sample_rate;
+	silence_passthrough_push(gf->silence, audio, gf->channels);
 
-	info("exiting whisper thread");
+	{
+		std::lock_guard<std::mutex> lock(whisper_outbuf_mutex);
+		*out = output_packet(gf, audio, &gf->info_out_buffer, gf->output_buffers);
+	}
+	if (*out == nullptr && !windows_in_flight(gf)) {
+		*out = output_packet(gf, audio, &gf->silence.preroll_info,
+				     gf->silence.preroll_buffers);
+	}
+	return true;
 }
 
 struct obs_audio_data *cleanstream_filter_audio(void *data, struct obs_audio_data *audio)
@@ -639,11 +1614,38 @@ struct obs_audio_data *cleanstream_filter_audio(void *data, struct obs_audio_dat
 		return audio;
 	}
 
-	if (gf->whisper_context == nullptr) {
-		// Whisper not initialized, just pass through
+	gf->last_audio_ns = os_gettime_ns();
+	CLEANSTREAM_TRACE2(audio_in, audio->frames, audio->timestamp);
+
+	if (!gf->model_loaded) {
+		// Whisper not loaded yet (or unloaded while idle), have the filter's job load it
+		// and pass through in the meantime
+		if (!gf->model_load_failed) {
+			gf->model_requested = true;
+			schedule_whisper_job(gf);
+		}
+		if (!gf->failing_open) {
+			gf->failing_open = true;
+			gf->stats.fail_open_events++;
+		}
+		gf->stats.fail_open_ns += (uint64_t)audio->frames * 1000000000ULL / gf->sample_rate;
+		CLEANSTREAM_TRACE1(fail_open, audio->frames);
 		return audio;
 	}
+	gf->failing_open = false;
+
+	// the delay line output keeps a fixed latency, silence goes through it as usual
+	struct obs_audio_data *silence_out = nullptr;
+	if (gf->silence.enabled && !gf->delay.catchup_enabled && !gf->delay.cut_enabled &&
+	    !gf->tap_mode) {
+		if (silence_fast_path(gf, audio, &silence_out)) {
+			return silence_out;
+		}
+	} else {
+		end_silence(gf);
+	}
 
+	bool segment_ready = false;
 	{
 		std::lock_guard<std::mutex> lock(whisper_buf_mutex); // scoped lock
 		do_log(gf->log_level,
@@ -658,42 +1660,27 @@ struct obs_audio_data *cleanstream_filter_audio(void *data, struct obs_audio_dat
 		struct cleanstream_audio_info info = {0};
 		info.frames = audio->frames;       // number of frames in this packet
 		info.timestamp = audio->timestamp; // timestamp of this packet
+		info.source_frames = audio->frames;
 		circlebuf_push_back(&gf->info_buffer, &info, sizeof(info));
+		segment_ready = gf->input_buffers[0].size >= gf->frames * sizeof(float);
+	}
+	if (segment_ready) {
+		schedule_whisper_job(gf);
 	}
 
-	// Check for output to play
-	struct cleanstream_audio_info info_out = {0};
-	{
-		std::lock_guard<std::mutex> lock(whisper_outbuf_mutex); // scoped lock
-
-		if (gf->info_out_buffer.size == 0) {
-			// nothing to output
-			return NULL;
-		}
-
-		// pop from output buffers to get audio packet info
-		circlebuf_pop_front(&gf->info_out_buffer, &info_out, sizeof(info_out));
-		do_log(gf->log_level,
-		       "output packet info: timestamp=%" PRIu64 ", frames=%" PRIu32
-		       ", bytes=%lu, ms=%u",
-		       info_out.timestamp, info_out.frames, gf->output_buffers[0].size,
-		       info_out.frames * 1000 / gf->sample_rate);
-
-		// prepare output data buffer
-		da_resize(gf->output_data, info_out.frames * gf->channels);
-
-		// pop from output circlebuf to audio data
-		for (size_t i = 0; i < gf->channels; i++) {
-			gf->output_audio.data[i] =
-				(uint8_t *)&gf->output_data.array[i * info_out.frames];
-			circlebuf_pop_front(&gf->output_buffers[i], gf->output_audio.data[i],
-					    info_out.frames * sizeof(float));
-		}
+	if (gf->tap_mode) {
+		// analysis only, the packet goes out as it came in
+		gf->added_latency_ns = 0;
+		CLEANSTREAM_TRACE3(audio_out, audio->frames, audio->timestamp, (uint64_t)0);
+		return audio;
+	}
+	if (gf->delay.catchup_enabled || gf->delay.cut_enabled) {
+		return output_delay_line_audio(gf, audio);
 	}
 
-	gf->output_audio.frames = info_out.frames;
-	gf->output_audio.timestamp = info_out.timestamp;
-	return &gf->output_audio;
+	// Check for output to play
+	std::lock_guard<std::mutex> lock(whisper_outbuf_mutex);
+	return output_packet(gf, audio, &gf->info_out_buffer, gf->output_buffers);
 }
 
 const char *cleanstream_name(void *unused)
@@ -705,20 +1692,35 @@ const char *cleanstream_name(void *unused)
 void cleanstream_destroy(void *data)
 {
 	struct cleanstream_data *gf = static_cast<struct cleanstream_data *>(data);
+	control_plane_timer timer(CONTROL_PLANE_DESTROY, obs_source_get_name(gf->context));
 
 	info("cleanstream_destroy");
+	// stop scheduling and wait for a pending job
+	gf->stopping = true;
+	obs_frontend_remove_event_callback(cleanstream_frontend_event, gf);
+	inference_pool_remove_housekeeping(gf);
+	{
+		std::unique_lock<std::mutex> lock(gf->job_mutex);
+		gf->job_cv.wait(lock, [gf] { return gf->jobs_running == 0 && !gf->shadow.pending; });
+	}
 	{
 		std::lock_guard<std::mutex> lock(whisper_ctx_mutex);
-		if (gf->whisper_context != nullptr) {
-			whisper_free(gf->whisper_context);
-			gf->whisper_context = nullptr;
-		}
+		release_whisper_model(gf);
 	}
-	// join the thread
-	gf->whisper_thread.join();
+	shadow_runner_release(gf->shadow, obs_source_get_name(gf->context));
+	session_report_write(gf->stats, obs_source_get_name(gf->context), "filter removed");
 
-	if (gf->resampler) {
-		audio_resampler_destroy(gf->resampler);
+	for (struct analysis_slot &slot : gf->slots) {
+		if (slot.resampler) {
+			audio_resampler_destroy(slot.resampler);
+		}
+		for (audio_resampler_t *resampler : slot.channel_resamplers) {
+			if (resampler) {
+				audio_resampler_destroy(resampler);
+			}
+		}
+	}
+	if (gf->resampler_back) {
 		audio_resampler_destroy(gf->resampler_back);
 	}
 	{
@@ -729,66 +1731,127 @@ void cleanstream_destroy(void *data)
 		for (size_t i = 0; i < gf->channels; i++) {
 			circlebuf_free(&gf->input_buffers[i]);
 			circlebuf_free(&gf->output_buffers[i]);
-			da_free(gf->copy_output_buffers[i]);
 		}
 	}
 	circlebuf_free(&gf->info_buffer);
 	circlebuf_free(&gf->info_out_buffer);
+	silence_passthrough_free(gf->silence);
 	da_free(gf->output_data);
 
+	gf->~cleanstream_data();
 	bfree(gf);
 }
 
 void cleanstream_update(void *data, obs_data_t *s)
 {
 	struct cleanstream_data *gf = static_cast<struct cleanstream_data *>(data);
+	control_plane_timer timer(CONTROL_PLANE_UPDATE, obs_source_get_name(gf->context));
 
 	gf->filler_p_threshold = (float)obs_data_get_double(s, "filler_p_threshold");
 	gf->log_level = (int)obs_data_get_int(s, "log_level");
 	gf->do_silence = obs_data_get_bool(s, "do_silence");
 	gf->vad_enabled = obs_data_get_bool(s, "vad_enabled");
-	gf->detect_regex = obs_data_get_string(s, "detect_regex");
-	gf->beep_regex = obs_data_get_string(s, "beep_regex");
+	update_rules(gf, obs_data_get_string(s, "detect_regex"),
+		     obs_data_get_string(s, "beep_regex"));
+	{
+		std::lock_guard<std::mutex> lock(gf->lexicon_mutex);
+		const std::string lexicon_path = obs_data_get_string(s, "lexicon_path");
+		if (lexicon_path != gf->lexicon_path) {
+			gf->lexicon_path = lexicon_path;
+			gf->lexicon.reset();
+			gf->lexicon_failed = false;
+		}
+	}
+	refresh_lexicon(gf);
 	gf->log_words = obs_data_get_bool(s, "log_words");
+	gf->silence.enabled = obs_data_get_bool(s, "silence_fast_path");
+	gf->unload_idle_ms = (uint64_t)obs_data_get_int(s, "unload_idle_sec") * 1000;
+
+	const int recorder_minutes = (int)obs_data_get_int(s, "flight_recorder_minutes");
+	if (recorder_minutes != gf->recorder_minutes) {
+		gf->recorder_minutes = recorder_minutes;
+		flight_recorder_init(gf->recorder, (size_t)recorder_minutes * 60 *
+							   FLIGHT_RECORDER_SEGMENTS_PER_SEC);
+	}
+	gf->delay.target_ns = (uint64_t)obs_data_get_int(s, "catchup_target_ms") * 1000000;
+	gf->delay.max_speedup = (double)obs_data_get_int(s, "catchup_max_percent") / 100.0;
+	gf->delay.cut_max_frames_per_min =
+		(uint64_t)obs_data_get_int(s, "cut_max_sec_per_min") * gf->sample_rate;
+	const bool was_delay_line = gf->delay.catchup_enabled || gf->delay.cut_enabled;
+	const bool was_tap_mode = gf->tap_mode;
+	gf->delay.catchup_enabled = obs_data_get_bool(s, "catchup_enabled");
+	gf->delay.cut_enabled = obs_data_get_bool(s, "cut_enabled");
+	gf->tap_mode = obs_data_get_bool(s, "tap_mode");
+	if (was_delay_line != (gf->delay.catchup_enabled || gf->delay.cut_enabled) ||
+	    was_tap_mode != gf->tap_mode) {
+		// the delay line times the output differently, start over
+		reset_audio_buffers(gf);
+	}
+
+	gf->recorder_latency_ms = (uint32_t)obs_data_get_int(s, "flight_recorder_latency_ms");
+	gf->recorder_inference_ms = (uint32_t)obs_data_get_int(s, "flight_recorder_inference_ms");
 
 	const char *new_model_path = obs_data_get_string(s, "whisper_model_path");
 	if (strcmp(new_model_path, gf->whisper_model_path.c_str()) != 0) {
-		// model path changed, reload the model
+		// model path changed, free the current model. The filter's job loads the new
+		// one when the filter receives audio.
 		info("model path changed, reloading model");
-		if (gf->whisper_context != nullptr) {
-			// acquire the mutex before freeing the context
+		{
 			std::lock_guard<std::mutex> lock(whisper_ctx_mutex);
-			whisper_free(gf->whisper_context);
-			gf->whisper_context = nullptr;
-		}
-		if (gf->whisper_thread.joinable()) {
-			gf->whisper_thread.join();
+			release_whisper_model(gf);
+			gf->whisper_model_path = new_model_path;
+			gf->model_load_failed = false;
 		}
-		gf->whisper_model_path = bstrdup(new_model_path);
 
 		// check if the model exists, if not, download it
-		if (!check_if_model_exists(gf->whisper_model_path)) {
+		if (!check_if_model_exists(new_model_path)) {
 			error("Whisper model does not exist");
-			download_model_with_ui_dialog(
-				gf->whisper_model_path, [gf](int download_status) {
-					if (download_status == 0) {
-						info("Model download complete");
-						gf->whisper_context = init_whisper_context(
-							gf->whisper_model_path);
-						gf->whisper_thread = std::thread(whisper_loop, gf);
-					} else {
-						error("Model download failed");
-					}
-				});
-		} else {
-			// Model exists, just load it
-			gf->whisper_context = init_whisper_context(gf->whisper_model_path);
-			gf->whisper_thread = std::thread(whisper_loop, gf);
+			download_model_with_ui_dialog(new_model_path, [gf](int download_status) {
+				if (download_status == 0) {
+					info("Model download complete");
+					gf->model_load_failed = false;
+				} else {
+					error("Model download failed");
+				}
+			});
 		}
 	}
 
+	shadow_config shadow_settings;
+	shadow_settings.enabled = obs_data_get_bool(s, "shadow_enabled");
+	shadow_settings.model_path = obs_data_get_string(s, "shadow_model_path");
+	shadow_settings.n_threads = (int)obs_data_get_int(s, "shadow_n_threads");
+	shadow_settings.audio_ctx = (int)obs_data_get_int(s, "shadow_audio_ctx");
+	shadow_settings.sampling_strategy = (int)obs_data_get_int(s, "shadow_sampling_method");
+	shadow_settings.beam_size = (int)obs_data_get_int(s, "shadow_beam_size");
+	shadow_settings.temperature = (float)obs_data_get_double(s, "shadow_temperature");
+	if (shadow_runner_update(gf->shadow, shadow_settings)) {
+		// log the statistics and free the shadow model
+		schedule_shadow_job(gf, nullptr);
+	}
+
+	inference_thread_config thread_config;
+	thread_config.cpu_set = obs_data_get_string(s, "inference_cpu_set");
+	thread_config.physical_cores_only = obs_data_get_bool(s, "inference_physical_cores");
+	thread_config.priority = (int)obs_data_get_int(s, "inference_priority");
+	if (gf->tap_mode) {
+		// nobody waits for the results, stay out of the way of OBS
+		thread_config.priority = INFERENCE_PRIORITY_LOWEST;
+	}
+
 	std::lock_guard<std::mutex> lock(whisper_ctx_mutex);
 
+	gf->thread_config = thread_config;
+	gf->inference_priority = thread_config.priority;
+	gf->parallel_windows = std::clamp((int)obs_data_get_int(s, "parallel_windows"), 1,
+					  MAX_PARALLEL_WINDOWS);
+	gf->job_threads = (int)obs_data_get_int(s, "n_threads");
+	gf->per_channel = obs_data_get_bool(s, "per_channel");
+	gf->pack_wait_ms = (uint32_t)obs_data_get_int(s, "pack_wait_ms");
+	gf->mix_sources = obs_data_get_bool(s, "mix_sources");
+	gf->analysis_speed = std::clamp(obs_data_get_double(s, "analysis_speed"), 1.0, 2.0);
+	gf->trim_audio_ctx = obs_data_get_bool(s, "trim_audio_ctx");
+
 	gf->whisper_params = whisper_full_default_params(
 		(whisper_sampling_strategy)obs_data_get_int(s, "whisper_sampling_method"));
 	gf->whisper_params.duration_ms = BUFFER_SIZE_MSEC;
@@ -820,8 +1883,9 @@ void cleanstream_update(void *data, obs_data_t *s)
 
 void *cleanstream_create(obs_data_t *settings, obs_source_t *filter)
 {
-	struct cleanstream_data *gf =
-		static_cast<struct cleanstream_data *>(bmalloc(sizeof(struct cleanstream_data)));
+	control_plane_timer timer(CONTROL_PLANE_CREATE, obs_source_get_name(filter));
+	void *data = bmalloc(sizeof(struct cleanstream_data));
+	struct cleanstream_data *gf = new (data) cleanstream_data();
 
 	// Get the number of channels for the input source
 	gf->channels = audio_output_get_channels(obs_get_audio());
@@ -832,10 +1896,14 @@ void *cleanstream_create(obs_data_t *settings, obs_source_t *filter)
 	for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++) {
 		circlebuf_init(&gf->input_buffers[i]);
 		circlebuf_init(&gf->output_buffers[i]);
+	}
+	for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++) {
 		gf->output_audio.data[i] = nullptr;
 	}
 	circlebuf_init(&gf->info_buffer);
 	circlebuf_init(&gf->info_out_buffer);
+	silence_passthrough_init(gf->silence);
+	gf->buffer_generation = 0;
 	da_init(gf->output_data);
 
 	gf->output_audio.frames = 0;
@@ -847,17 +1915,36 @@ void *cleanstream_create(obs_data_t *settings, obs_source_t *filter)
 	for (size_t c = 1; c < gf->channels; c++) { // set the channel pointers
 		gf->copy_buffers[c] = gf->copy_buffers[0] + c * gf->frames;
 	}
-	for (size_t c = 0; c < gf->channels; c++) { // initialize the copy-output buffers
-		da_init(gf->copy_output_buffers[c]);
-	}
 
 	gf->context = filter;
+	// the model is loaded by the filter's job when the filter first receives audio
 	gf->whisper_model_path = obs_data_get_string(settings, "whisper_model_path");
-	gf->whisper_context = init_whisper_context(gf->whisper_model_path);
-	if (gf->whisper_context == nullptr) {
-		error("Failed to load whisper model");
-		return nullptr;
-	}
+	gf->model_loaded = false;
+	gf->jobs_running = 0;
+	gf->job_threads = 1;
+	gf->parallel_windows = 1;
+	gf->per_channel = false;
+	gf->pack_wait_ms = 0;
+	gf->mix_sources = false;
+	gf->analysis_speed = 1.0;
+	gf->trim_audio_ctx = false;
+	gf->next_window_sequence = 0;
+	gf->next_commit_sequence = 0;
+	gf->recorder_minutes = -1;
+	gf->recorder_latency_ms = 0;
+	gf->recorder_inference_ms = 0;
+	gf->recorder_dump_reason = nullptr;
+	gf->recorder_last_auto_dump_ns = 0;
+	gf->added_latency_ns = 0;
+	gf->stats.start_ns = os_gettime_ns();
+	gf->report_reason = nullptr;
+	gf->failing_open = false;
+	gf->tap_mode = false;
+	gf->stopping = false;
+	gf->model_requested = false;
+	gf->model_load_failed = false;
+	gf->last_audio_ns = os_gettime_ns();
+	gf->numa_node = -1;
 
 	gf->overlap_ms = OVERLAP_SIZE_MSEC;
 	gf->overlap_frames = (size_t)((float)gf->sample_rate / (1000.0f / (float)gf->overlap_ms));
@@ -873,22 +1960,67 @@ void *cleanstream_create(obs_data_t *settings, obs_source_t *filter)
 	dst.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	dst.speakers = convert_speaker_layout((uint8_t)1);
 
-	gf->resampler = audio_resampler_create(&dst, &src);
+	// per-channel analysis resamples every channel on its own
+	struct resample_info channel_src = src;
+	channel_src.speakers = SPEAKERS_MONO;
+	const size_t n_channel_resamplers =
+		gf->channels > 1 ? std::min(gf->channels, (size_t)MAX_ANALYZED_CHANNELS) : 0;
+	for (struct analysis_slot &slot : gf->slots) {
+		slot.resampler = audio_resampler_create(&dst, &src);
+		for (size_t c = 0; c < n_channel_resamplers; c++) {
+			slot.channel_resamplers[c] = audio_resampler_create(&dst, &channel_src);
+		}
+	}
 	gf->resampler_back = audio_resampler_create(&src, &dst);
 
 	gf->active = true;
-	gf->detect_regex = nullptr;
-	gf->beep_regex = nullptr;
+	gf->rules = std::make_shared<struct detection_rules>();
+	gf->lexicon_failed = false;
 
 	// get the settings updated on the filter data struct
 	cleanstream_update(gf, settings);
 
-	// start the thread
-	gf->whisper_thread = std::thread(whisper_loop, gf);
+	inference_pool_add_housekeeping(gf, [gf]() { whisper_housekeeping(gf); });
+	obs_frontend_add_event_callback(cleanstream_frontend_event, gf);
 
 	return gf;
 }
 
+// Start the control plane benchmark from the Tools menu
+void control_plane_menu_clicked(void *)
+{
+	control_plane_benchmark_start(CONTROL_PLANE_BENCHMARK_SEC, CONTROL_PLANE_INTERVAL_MSEC);
+}
+
+// Start the control plane benchmark once OBS has loaded the scenes if
+// CLEANSTREAM_CONTROL_PLANE_BENCHMARK holds a duration in seconds, for unattended runs. Stop
+// it on exit while the UI thread still runs its tasks and the filters still exist.
+void control_plane_frontend_event(enum obs_frontend_event event, void *)
+{
+	const char *duration = getenv("CLEANSTREAM_CONTROL_PLANE_BENCHMARK");
+	if (event == OBS_FRONTEND_EVENT_FINISHED_LOADING && duration != nullptr &&
+	    atoi(duration) > 0) {
+		control_plane_benchmark_start((uint32_t)atoi(duration), CONTROL_PLANE_INTERVAL_MSEC);
+	} else if (event == OBS_FRONTEND_EVENT_EXIT) {
+		control_plane_benchmark_stop();
+	}
+}
+
+void cleanstream_module_load(void)
+{
+	obs_frontend_add_tools_menu_item("CleanStream control plane benchmark",
+					 control_plane_menu_clicked, nullptr);
+	obs_frontend_add_event_callback(control_plane_frontend_event, nullptr);
+}
+
+void cleanstream_module_unload(void)
+{
+	obs_frontend_remove_event_callback(control_plane_frontend_event, nullptr);
+	control_plane_benchmark_stop();
+	inference_pool_shutdown();
+	model_catalog_save_measurements();
+}
+
 void cleanstream_activate(void *data)
 {
 	struct cleanstream_data *gf = static_cast<struct cleanstream_data *>(data);
@@ -914,9 +2046,37 @@ void cleanstream_defaults(obs_data_t *s)
 	obs_data_set_default_string(
 		s, "beep_regex",
 		"(fuck)|(shit)|(bitch)|(cunt)|(pussy)|(dick)|(asshole)|(whore)|(cock)|(nigger)|(nigga)|(prick)");
+	obs_data_set_default_string(s, "lexicon_path", "");
 	obs_data_set_default_bool(s, "log_words", true);
 	obs_data_set_default_string(s, "whisper_model_path", "models/ggml-tiny.en.bin");
 	obs_data_set_default_string(s, "whisper_language_select", "en");
+	obs_data_set_default_int(s, "unload_idle_sec", 300);
+	obs_data_set_default_string(s, "inference_cpu_set", "");
+	obs_data_set_default_bool(s, "inference_physical_cores", false);
+	obs_data_set_default_int(s, "inference_priority", INFERENCE_PRIORITY_BELOW_NORMAL);
+	obs_data_set_default_int(s, "parallel_windows", 1);
+	obs_data_set_default_bool(s, "per_channel", false);
+	obs_data_set_default_int(s, "pack_wait_ms", 0);
+	obs_data_set_default_bool(s, "mix_sources", false);
+	obs_data_set_default_double(s, "analysis_speed", 1.0);
+	obs_data_set_default_bool(s, "trim_audio_ctx", false);
+	obs_data_set_default_bool(s, "silence_fast_path", true);
+	obs_data_set_default_bool(s, "tap_mode", false);
+	obs_data_set_default_bool(s, "cut_enabled", false);
+	obs_data_set_default_int(s, "cut_max_sec_per_min", 6);
+	obs_data_set_default_bool(s, "catchup_enabled", false);
+	obs_data_set_default_int(s, "catchup_target_ms", 1500);
+	obs_data_set_default_int(s, "catchup_max_percent", 8);
+	obs_data_set_default_int(s, "flight_recorder_minutes", 10);
+	obs_data_set_default_int(s, "flight_recorder_latency_ms", 3000);
+	obs_data_set_default_int(s, "flight_recorder_inference_ms", 2000);
+	obs_data_set_default_bool(s, "shadow_enabled", false);
+	obs_data_set_default_string(s, "shadow_model_path", "models/ggml-tiny.en.bin");
+	obs_data_set_default_int(s, "shadow_n_threads", 1);
+	obs_data_set_default_int(s, "shadow_audio_ctx", 0);
+	obs_data_set_default_int(s, "shadow_sampling_method", -1);
+	obs_data_set_default_int(s, "shadow_beam_size", 5);
+	obs_data_set_default_double(s, "shadow_temperature", 0.0);
 
 	// Whisper parameters
 	obs_data_set_default_int(s, "whisper_sampling_method", WHISPER_SAMPLING_BEAM_SEARCH);
@@ -943,14 +2103,66 @@ void cleanstream_defaults(obs_data_t *s)
 	obs_data_set_default_double(s, "length_penalty", -1.0);
 }
 
+// Fill a model list from the catalog, models this machine is known to run slower than real
+// time go last
+void add_model_list_items(obs_property_t *list)
+{
+	std::vector<model_info> models = get_model_catalog();
+	std::stable_partition(models.begin(), models.end(), [](const model_info &model) {
+		return model_expected_rtf(model) < 1.0;
+	});
+	for (const model_info &model : models) {
+		std::string label = model.name;
+		if (model.size > 0) {
+			label += " " + std::to_string((model.size + (1 << 20) - 1) >> 20) + "Mb";
+		}
+		const double rtf = model_expected_rtf(model);
+		if (rtf >= 1.0) {
+			label += " (too slow for real time)";
+		} else if (rtf > 0.0) {
+			char speed[32];
+			snprintf(speed, sizeof(speed), " (%.2fx real time)", rtf);
+			label += speed;
+		}
+		obs_property_list_add_string(list, label.c_str(), model.file.c_str());
+	}
+}
+
 obs_properties_t *cleanstream_properties(void *data)
 {
 	obs_properties_t *ppts = obs_properties_create();
 
+	// show which compute backend whisper.cpp was built with, e.g. "BLAS = 1"
+	const std::string system_info = whisper_print_system_info();
+	const bool has_blas = system_info.find("BLAS = 1") != std::string::npos;
+	obs_properties_add_text(ppts, "compute_backend",
+				has_blas ? "Compute backend: CPU with BLAS"
+					 : "Compute backend: CPU (ggml)",
+				OBS_TEXT_INFO);
+
 	obs_properties_add_float_slider(ppts, "filler_p_threshold", "filler_p_threshold", 0.0f,
 					1.0f, 0.05f);
 	obs_properties_add_bool(ppts, "do_silence", "do_silence");
 	obs_properties_add_bool(ppts, "vad_enabled", "vad_enabled");
+	obs_property_t *fast_path_prop = obs_properties_add_bool(
+		ppts, "silence_fast_path", "Pass digital silence through without delay");
+	obs_property_set_long_description(
+		fast_path_prop,
+		"When the source is muted or silent, skip the analysis and drop the delay.");
+	obs_property_t *tap_mode_prop =
+		obs_properties_add_bool(ppts, "tap_mode", "Analysis only (no audio delay)");
+	obs_property_set_long_description(
+		tap_mode_prop,
+		"Pass the audio through unchanged and only count and log the detections in the "
+		"session report. The analysis runs at the lowest priority and skips audio when "
+		"it falls behind.");
+	obs_property_t *per_channel_prop =
+		obs_properties_add_bool(ppts, "per_channel", "Analyze each channel on its own");
+	obs_property_set_long_description(
+		per_channel_prop,
+		"For a speaker on each channel: a filler or beep only affects its own channel. "
+		"Runs an inference for every channel with speech, each with its own whisper state. "
+		"With surround audio only the front left and right channels are analyzed.");
 	obs_property_t *list = obs_properties_add_list(ppts, "log_level", "log_level",
 						       OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
 	obs_property_list_add_int(list, "DEBUG", LOG_DEBUG);
@@ -959,21 +2171,162 @@ obs_properties_t *cleanstream_properties(void *data)
 	obs_properties_add_bool(ppts, "log_words", "log_words");
 	obs_properties_add_text(ppts, "detect_regex", "detect_regex", OBS_TEXT_DEFAULT);
 	obs_properties_add_text(ppts, "beep_regex", "beep_regex", OBS_TEXT_DEFAULT);
+	// word lists too large for beep_regex, compiled with cleanstream-lexicon
+	obs_property_t *lexicon_prop = obs_properties_add_path(
+		ppts, "lexicon_path", "Lexicon file", OBS_PATH_FILE, "Lexicon (*.lexicon)", nullptr);
+	obs_property_set_long_description(
+		lexicon_prop,
+		"A word list compiled with cleanstream-lexicon, checked after the expressions. "
+		"Reloaded when the file changes.");
 
 	// Add a list of available whisper models to download
 	obs_property_t *whisper_models_list =
 		obs_properties_add_list(ppts, "whisper_model_path", "Whisper Model",
 					OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
 
-	obs_property_list_add_string(whisper_models_list, "Tiny (Eng) 75Mb",
-				     "models/ggml-tiny.en.bin");
-	obs_property_list_add_string(whisper_models_list, "Tiny 75Mb", "models/ggml-tiny.bin");
-	obs_property_list_add_string(whisper_models_list, "Base (Eng) 142Mb",
-				     "models/ggml-base.en.bin");
-	obs_property_list_add_string(whisper_models_list, "Base 142Mb", "models/ggml-base.bin");
-	obs_property_list_add_string(whisper_models_list, "Small (Eng) 466Mb",
-				     "models/ggml-small.en.bin");
-	obs_property_list_add_string(whisper_models_list, "Small 466Mb", "models/ggml-small.bin");
+	add_model_list_items(whisper_models_list);
+
+	// unload the model from memory when the filter gets no audio for a while, 0 = never
+	obs_property_t *unload_idle = obs_properties_add_int_slider(
+		ppts, "unload_idle_sec", "Unload model when idle", 0, 3600, 30);
+	obs_property_int_set_suffix(unload_idle, " s");
+
+	obs_properties_t *inference_threads_group = obs_properties_create();
+	obs_properties_add_group(ppts, "inference_threads_group", "Inference Threads",
+				 OBS_GROUP_NORMAL, inference_threads_group);
+	obs_property_t *cpu_set = obs_properties_add_text(
+		inference_threads_group, "inference_cpu_set", "CPU set", OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(
+		cpu_set, "CPUs to run inference on, e.g. 2-5,8. Empty runs on any CPU.");
+	obs_properties_add_bool(inference_threads_group, "inference_physical_cores",
+				"Physical cores only (skip SMT siblings)");
+	obs_property_t *priority_list = obs_properties_add_list(
+		inference_threads_group, "inference_priority", "Priority", OBS_COMBO_TYPE_LIST,
+		OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(priority_list, "Normal", INFERENCE_PRIORITY_NORMAL);
+	obs_property_list_add_int(priority_list, "Below normal", INFERENCE_PRIORITY_BELOW_NORMAL);
+	obs_property_list_add_int(priority_list, "Lowest", INFERENCE_PRIORITY_LOWEST);
+	// analyze the next window while the previous one is still running, each window needs
+	// its own whisper state
+	obs_property_t *parallel_windows =
+		obs_properties_add_int_slider(inference_threads_group, "parallel_windows",
+					      "Concurrent analysis windows", 1, MAX_PARALLEL_WINDOWS, 1);
+	obs_property_set_long_description(
+		parallel_windows,
+		"Windows start a hop apart instead of after the previous one finished. "
+		"Uses one whisper state per window.");
+	obs_property_t *pack_wait = obs_properties_add_int_slider(
+		inference_threads_group, "pack_wait_ms", "Pack with other sources", 0, 200, 10);
+	obs_property_int_set_suffix(pack_wait, " ms");
+	obs_property_set_long_description(
+		pack_wait,
+		"Wait this long for segments of other sources using the same model and language, "
+		"and analyze them in one inference. Saves CPU with many sources, adds up to the "
+		"wait to the delay. 0 disables packing.");
+	obs_property_t *mix_sources = obs_properties_add_bool(
+		inference_threads_group, "mix_sources", "Analyze packed sources as one mix");
+	obs_property_set_long_description(
+		mix_sources,
+		"Sum the audio of the packed sources with this option like a mixer bus and analyze "
+		"the mix once, instead of each source. A detection edits every source of the mix. "
+		"The inference work stays the same however many microphones there are.");
+	obs_property_t *analysis_speed = obs_properties_add_float_slider(
+		inference_threads_group, "analysis_speed", "Analysis speed", 1.0, 2.0, 0.05);
+	obs_property_float_set_suffix(analysis_speed, "x");
+	obs_property_set_long_description(
+		analysis_speed,
+		"Shorten the audio given to whisper by this factor, keeping the pitch. Faster is "
+		"less accurate. The output audio is not changed. 1 disables. On its own this "
+		"does not save encoder work, whisper still encodes 30 s: together with \"Trim "
+		"encoder context\" the trimmed context shrinks with the audio.");
+	obs_property_t *trim_audio_ctx = obs_properties_add_bool(
+		inference_threads_group, "trim_audio_ctx", "Trim encoder context");
+	obs_property_set_long_description(
+		trim_audio_ctx,
+		"Encode only as much context as the analyzed audio needs, about 50 of whisper's "
+		"1500 positions for a one second window, instead of the padded 30 s. Most of the "
+		"speed gain of a short window comes from this, at a cost in accuracy that "
+		"depends on the model. Not used for packed segments.");
+
+	// remove fillers from the audio instead of silencing them, shortening the stream
+	obs_properties_t *cut_group = obs_properties_create();
+	obs_properties_add_group(ppts, "cut_enabled", "Cut Fillers", OBS_GROUP_CHECKABLE,
+				 cut_group);
+	obs_property_t *cut_max = obs_properties_add_int_slider(
+		cut_group, "cut_max_sec_per_min", "Max cut per minute", 1, 30, 1);
+	obs_property_int_set_suffix(cut_max, " s");
+	obs_property_set_long_description(
+		cut_max,
+		"Fillers beyond this are silenced, as are fillers the delay line has too little audio "
+		"queued to give up. The audio starts with the target latency of Latency Catch-up and "
+		"every cut takes its length off the latency, which is given back in the next "
+		"pauses by lengthening them.");
+
+	// keep the added latency at a target by playing slightly faster after a backlog
+	obs_properties_t *catchup_group = obs_properties_create();
+	obs_properties_add_group(ppts, "catchup_enabled", "Latency Catch-up", OBS_GROUP_CHECKABLE,
+				 catchup_group);
+	obs_property_t *catchup_target = obs_properties_add_int(
+		catchup_group, "catchup_target_ms", "Target latency", 1100, 10000, 100);
+	obs_property_int_set_suffix(catchup_target, " ms");
+	obs_property_set_long_description(
+		catchup_target,
+		"The audio is delayed by this much. Should exceed the segment length plus the inference time.");
+	obs_property_t *catchup_max = obs_properties_add_int_slider(
+		catchup_group, "catchup_max_percent", "Max speed-up", 3, 8, 1);
+	obs_property_int_set_suffix(catchup_max, "%");
+
+	// the last minutes of analyzed segments, written to the plugin config directory
+	obs_properties_t *recorder_group = obs_properties_create();
+	obs_properties_add_group(ppts, "flight_recorder_group", "Flight Recorder",
+				 OBS_GROUP_NORMAL, recorder_group);
+	obs_property_t *recorder_minutes = obs_properties_add_int_slider(
+		recorder_group, "flight_recorder_minutes", "Keep last", 0, 60, 1);
+	obs_property_int_set_suffix(recorder_minutes, " min");
+	obs_property_t *recorder_latency = obs_properties_add_int(
+		recorder_group, "flight_recorder_latency_ms", "Save when added latency exceeds", 0,
+		60000, 100);
+	obs_property_int_set_suffix(recorder_latency, " ms");
+	obs_property_t *recorder_inference = obs_properties_add_int(
+		recorder_group, "flight_recorder_inference_ms", "Save when inference exceeds", 0,
+		60000, 100);
+	obs_property_int_set_suffix(recorder_inference, " ms");
+	obs_properties_add_button2(
+		recorder_group, "flight_recorder_dump", "Save flight recorder now",
+		[](obs_properties_t *, obs_property_t *, void *data_) {
+			struct cleanstream_data *gf_ = static_cast<struct cleanstream_data *>(data_);
+			gf_->recorder_dump_reason = "requested";
+			return false;
+		},
+		data);
+
+	// a candidate config run in the background on the same audio, only logged
+	obs_properties_t *shadow_group = obs_properties_create();
+	obs_properties_add_group(ppts, "shadow_enabled", "Shadow Mode", OBS_GROUP_CHECKABLE,
+				 shadow_group);
+	obs_property_t *shadow_models_list =
+		obs_properties_add_list(shadow_group, "shadow_model_path", "Shadow Model",
+					OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	add_model_list_items(shadow_models_list);
+	obs_properties_add_int_slider(shadow_group, "shadow_n_threads", "Shadow threads", 1, 8, 1);
+	obs_property_t *shadow_audio_ctx = obs_properties_add_int_slider(
+		shadow_group, "shadow_audio_ctx", "Shadow audio context", 0, 1500, 10);
+	obs_property_set_long_description(
+		shadow_audio_ctx, "Encoder context size, 0 uses the full context. Smaller is faster.");
+	obs_property_t *shadow_sampling_list = obs_properties_add_list(
+		shadow_group, "shadow_sampling_method", "Shadow decoding", OBS_COMBO_TYPE_LIST,
+		OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(shadow_sampling_list, "Same as live", -1);
+	obs_property_list_add_int(shadow_sampling_list, "Beam search",
+				  WHISPER_SAMPLING_BEAM_SEARCH);
+	obs_property_list_add_int(shadow_sampling_list, "Greedy", WHISPER_SAMPLING_GREEDY);
+	obs_property_t *shadow_beam_size = obs_properties_add_int_slider(
+		shadow_group, "shadow_beam_size", "Shadow beam size", 1, 8, 1);
+	obs_property_set_long_description(
+		shadow_beam_size,
+		"Beams of a beam search, or candidates of greedy sampling above temperature 0.");
+	obs_properties_add_float_slider(shadow_group, "shadow_temperature", "Shadow temperature",
+					0.0, 1.0, 0.05);
 
 	obs_properties_t *whisper_params_group = obs_properties_create();
 	obs_properties_add_group(ppts, "whisper_params_group", "Whisper Parameters",
@@ -1050,6 +2403,5 @@ obs_properties_t *cleanstream_properties(void *data)
 	obs_properties_add_float_slider(whisper_params_group, "length_penalty", "length_penalty",
 					-1.0f, 1.0f, 0.1f);
 
-	UNUSED_PARAMETER(data);
 	return ppts;
 }
@@ -13,6 +13,8 @@ struct obs_audio_data *cleanstream_filter_audio(void *data, struct obs_audio_dat
 void cleanstream_deactivate(void *data);
 void cleanstream_defaults(obs_data_t *s);
 obs_properties_t *cleanstream_properties(void *data);
+void cleanstream_module_load(void);
+void cleanstream_module_unload(void);
 
 #ifdef __cplusplus
 }
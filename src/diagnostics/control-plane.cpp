@@ -0,0 +1,401 @@
+#include "control-plane.h"
+#include "tracepoints.h"
+#include "plugin-support.h"
+#include "../model-utils/model-catalog.h"
+#include "../model-utils/model-store.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// the filter's id, in cleanstream-filter.c
+#define CLEANSTREAM_FILTER_ID "cleanstream_audio_filter"
+// create and destroy a copy of a filter and switch the models every this many ticks
+#define BENCHMARK_CREATE_EVERY 20
+
+static const char *const CALL_NAMES[CONTROL_PLANE_CALLS] = {"create", "update", "destroy"};
+
+namespace {
+
+std::mutex control_plane_mutex;
+// durations recorded while a benchmark runs, protected by control_plane_mutex
+bool collecting = false;
+std::vector<uint64_t> samples_ns[CONTROL_PLANE_CALLS];
+
+std::thread benchmark_thread;
+std::mutex benchmark_mutex;
+std::condition_variable benchmark_cv;
+std::atomic<bool> benchmark_running{false};
+// protected by benchmark_mutex
+bool benchmark_stop = false;
+uint64_t benchmark_run = 0;
+
+// settings the benchmark changes, each reaching an expensive part of the filter's update
+enum benchmark_toggle {
+	// both reset the audio buffers
+	TOGGLE_TAP_MODE,
+	TOGGLE_CUT,
+	// releases the model, waiting for a running inference
+	TOGGLE_MODEL,
+	TOGGLE_COUNT,
+};
+
+// a filter under benchmark and the settings to restore afterwards
+struct benchmark_filter {
+	obs_source_t *source = nullptr;
+	bool tap_mode = false;
+	bool cut_enabled = false;
+	std::string model_path;
+	// a downloaded model to switch to, empty to leave the model alone
+	std::string other_model_path;
+	// which settings differ from the original ones
+	bool toggled[TOGGLE_COUNT] = {};
+};
+
+// filters a stopped benchmark left changed, restored by control_plane_benchmark_stop on the UI
+// thread, protected by benchmark_mutex
+std::vector<benchmark_filter> unrestored_filters;
+
+// work the benchmark thread hands to the UI thread
+struct ui_task {
+	std::function<void()> work;
+	uint64_t run = 0;
+	bool done = false;
+};
+
+void record(enum control_plane_call call, const std::string &source_name, uint64_t duration_ns)
+{
+	CLEANSTREAM_TRACE2(control_plane, (int)call, duration_ns);
+	if (duration_ns > (uint64_t)CONTROL_PLANE_BUDGET_MS * 1000000) {
+		obs_log(LOG_WARNING, "[%s] %s blocked the UI thread for %.1f ms",
+			source_name.c_str(), CALL_NAMES[call], (double)duration_ns / 1e6);
+	}
+	std::lock_guard<std::mutex> lock(control_plane_mutex);
+	if (collecting) {
+		samples_ns[call].push_back(duration_ns);
+	}
+}
+
+double percentile_ms(const std::vector<uint64_t> &sorted, double p)
+{
+	if (sorted.empty()) {
+		return 0.0;
+	}
+	const size_t index = std::min(sorted.size() - 1, (size_t)(p * (double)sorted.size()));
+	return (double)sorted[index] / 1e6;
+}
+
+void add_filter(obs_source_t *parent, obs_source_t *filter, void *data)
+{
+	UNUSED_PARAMETER(parent);
+	if (strcmp(obs_source_get_unversioned_id(filter), CLEANSTREAM_FILTER_ID) == 0) {
+		static_cast<std::vector<obs_source_t *> *>(data)->push_back(
+			obs_source_get_ref(filter));
+	}
+}
+
+bool add_source_filters(void *data, obs_source_t *source)
+{
+	obs_source_enum_filters(source, add_filter, data);
+	return true;
+}
+
+// The report of a finished run, false if a call went over the budget
+bool write_report(uint32_t duration_sec, uint32_t interval_ms, size_t n_filters)
+{
+	std::vector<uint64_t> samples[CONTROL_PLANE_CALLS];
+	{
+		std::lock_guard<std::mutex> lock(control_plane_mutex);
+		collecting = false;
+		for (size_t i = 0; i < CONTROL_PLANE_CALLS; i++) {
+			samples[i].swap(samples_ns[i]);
+		}
+	}
+
+	obs_data_t *report = obs_data_create();
+	obs_data_set_int(report, "duration_sec", duration_sec);
+	obs_data_set_int(report, "interval_ms", interval_ms);
+	obs_data_set_int(report, "filters", (long long)n_filters);
+	obs_data_set_int(report, "budget_ms", CONTROL_PLANE_BUDGET_MS);
+	bool pass = true;
+	for (size_t i = 0; i < CONTROL_PLANE_CALLS; i++) {
+		std::sort(samples[i].begin(), samples[i].end());
+		const double p99_ms = percentile_ms(samples[i], 0.99);
+		const double max_ms = percentile_ms(samples[i], 1.0);
+		obs_data_t *call = obs_data_create();
+		obs_data_set_int(call, "count", (long long)samples[i].size());
+		obs_data_set_double(call, "p50_ms", percentile_ms(samples[i], 0.5));
+		obs_data_set_double(call, "p99_ms", p99_ms);
+		obs_data_set_double(call, "max_ms", max_ms);
+		obs_data_set_obj(report, CALL_NAMES[i], call);
+		obs_data_release(call);
+		const bool call_pass = p99_ms <= CONTROL_PLANE_BUDGET_MS;
+		pass = pass && call_pass;
+		obs_log(LOG_INFO,
+			"control plane benchmark: %s %d calls, p50 %.1f ms, p99 %.1f ms, max %.1f ms",
+			CALL_NAMES[i], (int)samples[i].size(), percentile_ms(samples[i], 0.5),
+			p99_ms, max_ms);
+		if (!call_pass) {
+			obs_log(LOG_ERROR,
+				"control plane benchmark FAILED: p99 of %s is %.1f ms, over the %d ms budget, the UI thread stalls",
+				CALL_NAMES[i], p99_ms, CONTROL_PLANE_BUDGET_MS);
+		}
+	}
+	obs_data_set_bool(report, "pass", pass);
+
+	char *dir = obs_module_config_path("reports");
+	os_mkdirs(dir);
+	char time_str[32];
+	const time_t now = time(nullptr);
+	strftime(time_str, sizeof(time_str), "%Y-%m-%d_%H-%M-%S", localtime(&now));
+	const std::string path = std::string(dir) + "/control-plane_" + time_str + ".json";
+	bfree(dir);
+	if (obs_data_save_json(report, path.c_str())) {
+		obs_log(pass ? LOG_INFO : LOG_ERROR,
+			"control plane benchmark %s the %d ms budget: %s",
+			pass ? "met" : "FAILED", CONTROL_PLANE_BUDGET_MS, path.c_str());
+	} else {
+		obs_log(LOG_WARNING, "Failed to write control plane report %s", path.c_str());
+	}
+	obs_data_release(report);
+	return pass;
+}
+
+void run_ui_task(void *param)
+{
+	std::unique_ptr<std::shared_ptr<ui_task>> task(
+		static_cast<std::shared_ptr<ui_task> *>(param));
+	bool skip;
+	{
+		std::lock_guard<std::mutex> lock(benchmark_mutex);
+		// the benchmark that queued it is gone
+		skip = benchmark_stop || (*task)->run != benchmark_run;
+	}
+	if (!skip) {
+		(*task)->work();
+	}
+	{
+		std::lock_guard<std::mutex> lock(benchmark_mutex);
+		(*task)->done = true;
+	}
+	benchmark_cv.notify_all();
+}
+
+// Run work on the UI thread, where OBS calls the filter's create, update and destroy and where
+// they must not run concurrently, and wait for it. False if the benchmark was stopped. Not
+// waiting in obs_queue_task: stopping runs on the UI thread and waits for the benchmark.
+bool run_on_ui_thread(std::function<void()> work)
+{
+	auto task = std::make_shared<ui_task>();
+	task->work = std::move(work);
+	{
+		std::lock_guard<std::mutex> lock(benchmark_mutex);
+		task->run = benchmark_run;
+	}
+	obs_queue_task(OBS_TASK_UI, run_ui_task, new std::shared_ptr<ui_task>(task), false);
+	std::unique_lock<std::mutex> lock(benchmark_mutex);
+	benchmark_cv.wait(lock, [&task] { return task->done || benchmark_stop; });
+	return !benchmark_stop;
+}
+
+// A downloaded model other than model_path, empty if there is none or model_path itself is
+// missing: switching to a missing model opens the download dialog
+std::string other_downloaded_model(const std::string &model_path)
+{
+	if (find_model_file(model_path).empty()) {
+		return "";
+	}
+	for (const model_info &info : get_model_catalog()) {
+		if (info.file != model_path && !find_model_file(info.file).empty()) {
+			return info.file;
+		}
+	}
+	return "";
+}
+
+benchmark_filter make_benchmark_filter(obs_source_t *source)
+{
+	benchmark_filter filter;
+	filter.source = source;
+	obs_data_t *settings = obs_source_get_settings(source);
+	filter.tap_mode = obs_data_get_bool(settings, "tap_mode");
+	filter.cut_enabled = obs_data_get_bool(settings, "cut_enabled");
+	filter.model_path = obs_data_get_string(settings, "whisper_model_path");
+	obs_data_release(settings);
+	filter.other_model_path = other_downloaded_model(filter.model_path);
+	return filter;
+}
+
+// Set the changed settings, or the original ones where restore is set, and update the filter
+void apply_settings(benchmark_filter &filter, bool restore)
+{
+	obs_data_t *changes = obs_data_create();
+	obs_data_set_bool(changes, "tap_mode",
+			  filter.tap_mode != (filter.toggled[TOGGLE_TAP_MODE] && !restore));
+	obs_data_set_bool(changes, "cut_enabled",
+			  filter.cut_enabled != (filter.toggled[TOGGLE_CUT] && !restore));
+	obs_data_set_string(changes, "whisper_model_path",
+			    filter.toggled[TOGGLE_MODEL] && !restore
+				    ? filter.other_model_path.c_str()
+				    : filter.model_path.c_str());
+	obs_source_update(filter.source, changes);
+	obs_data_release(changes);
+}
+
+// called on the UI thread
+void restore_filters(std::vector<benchmark_filter> &filters)
+{
+	for (benchmark_filter &filter : filters) {
+		apply_settings(filter, true);
+		obs_source_release(filter.source);
+	}
+	filters.clear();
+}
+
+void run_benchmark(uint32_t duration_sec, uint32_t interval_ms)
+{
+	std::vector<obs_source_t *> sources;
+	obs_enum_sources(add_source_filters, &sources);
+	std::vector<benchmark_filter> filters;
+	const size_t n_filters = sources.size();
+	int switching_models = 0;
+	for (obs_source_t *source : sources) {
+		filters.push_back(make_benchmark_filter(source));
+		switching_models += filters.back().other_model_path.empty() ? 0 : 1;
+	}
+	obs_log(LOG_INFO, "control plane benchmark: %d filters, %u s, an update every %u ms",
+		(int)filters.size(), duration_sec, interval_ms);
+	if (switching_models < (int)filters.size()) {
+		obs_log(LOG_WARNING,
+			"control plane benchmark: %d filters have no second downloaded model, their model is not switched",
+			(int)filters.size() - switching_models);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(control_plane_mutex);
+		for (std::vector<uint64_t> &samples : samples_ns) {
+			samples.clear();
+		}
+		collecting = true;
+	}
+
+	const uint64_t end_ns = os_gettime_ns() + (uint64_t)duration_sec * 1000000000ULL;
+	bool stopped = false;
+	for (uint64_t tick = 0; !filters.empty() && !stopped && os_gettime_ns() < end_ns;
+	     tick++) {
+		// tap mode and cutting in turn, the model every so often to let inferences run
+		enum benchmark_toggle toggle = tick % 2 == 0 ? TOGGLE_TAP_MODE : TOGGLE_CUT;
+		if (tick % BENCHMARK_CREATE_EVERY == BENCHMARK_CREATE_EVERY - 1) {
+			toggle = TOGGLE_MODEL;
+		}
+		for (size_t i = 0; i < filters.size() && !stopped; i++) {
+			benchmark_filter &filter = filters[i];
+			if (toggle == TOGGLE_MODEL && filter.other_model_path.empty()) {
+				continue;
+			}
+			stopped = !run_on_ui_thread([&filter, toggle] {
+				filter.toggled[toggle] = !filter.toggled[toggle];
+				apply_settings(filter, false);
+			});
+		}
+		if (tick % BENCHMARK_CREATE_EVERY == 0 && !stopped) {
+			obs_source_t *filter =
+				filters[(tick / BENCHMARK_CREATE_EVERY) % filters.size()].source;
+			stopped = !run_on_ui_thread([filter] {
+				obs_data_t *settings = obs_source_get_settings(filter);
+				obs_source_t *copy = obs_source_create_private(
+					CLEANSTREAM_FILTER_ID, "control plane benchmark", settings);
+				obs_data_release(settings);
+				obs_source_release(copy);
+			});
+		}
+		std::unique_lock<std::mutex> lock(benchmark_mutex);
+		stopped = stopped ||
+			  benchmark_cv.wait_for(lock, std::chrono::milliseconds(interval_ms),
+						[] { return benchmark_stop; });
+	}
+
+	if (!stopped) {
+		stopped = !run_on_ui_thread([&filters] { restore_filters(filters); });
+	}
+	if (stopped) {
+		// the UI thread is waiting in control_plane_benchmark_stop, which restores them
+		std::lock_guard<std::mutex> lock(benchmark_mutex);
+		unrestored_filters = std::move(filters);
+	}
+
+	if (stopped) {
+		std::lock_guard<std::mutex> lock(control_plane_mutex);
+		collecting = false;
+	} else if (n_filters == 0) {
+		std::lock_guard<std::mutex> lock(control_plane_mutex);
+		collecting = false;
+		obs_log(LOG_WARNING, "control plane benchmark: no CleanStream filters to update");
+	} else {
+		write_report(duration_sec, interval_ms, n_filters);
+	}
+	benchmark_running = false;
+}
+
+} // namespace
+
+control_plane_timer::control_plane_timer(enum control_plane_call call, const char *source_name)
+	: call(call),
+	  source_name(source_name != nullptr ? source_name : ""),
+	  start_ns(os_gettime_ns())
+{
+}
+
+control_plane_timer::~control_plane_timer()
+{
+	record(call, source_name, os_gettime_ns() - start_ns);
+}
+
+bool control_plane_benchmark_start(uint32_t duration_sec, uint32_t interval_ms)
+{
+	if (benchmark_running.exchange(true)) {
+		obs_log(LOG_WARNING, "control plane benchmark already running");
+		return false;
+	}
+	if (benchmark_thread.joinable()) {
+		benchmark_thread.join();
+	}
+	{
+		std::lock_guard<std::mutex> lock(benchmark_mutex);
+		benchmark_stop = false;
+		benchmark_run++;
+	}
+	benchmark_thread = std::thread(run_benchmark, duration_sec, interval_ms);
+	return true;
+}
+
+void control_plane_benchmark_stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(benchmark_mutex);
+		benchmark_stop = true;
+	}
+	benchmark_cv.notify_all();
+	if (benchmark_thread.joinable()) {
+		benchmark_thread.join();
+	}
+
+	std::vector<benchmark_filter> filters;
+	{
+		std::lock_guard<std::mutex> lock(benchmark_mutex);
+		filters.swap(unrestored_filters);
+	}
+	restore_filters(filters);
+}
@@ -0,0 +1,48 @@
+#ifndef CONTROL_PLANE_H
+#define CONTROL_PLANE_H
+
+#include <cstdint>
+#include <string>
+
+// Wall time of the filter's create, update and destroy, which OBS calls on its UI thread on
+// scene switches and property edits. A call over the budget freezes the UI for a frame or
+// more and is logged as a stall.
+//
+// The benchmark measures them under load, while the filters keep analyzing their audio: for a
+// while it changes a setting of every CleanStream filter every interval, tap mode and cutting
+// in turn, which reset the audio buffers, and every 20 intervals the model, which waits for a
+// running inference. It also creates and destroys a copy of one filter every 20 intervals.
+// All of it runs on the UI thread like the property edits it stands for, the original
+// settings are restored at the end. The percentiles of each call go to
+// reports/control-plane_<time>.json with whether the 99th percentile stayed in the budget, a
+// miss is logged as an error.
+
+// one frame at 60 fps
+#define CONTROL_PLANE_BUDGET_MS 16
+
+enum control_plane_call {
+	CONTROL_PLANE_CREATE,
+	CONTROL_PLANE_UPDATE,
+	CONTROL_PLANE_DESTROY,
+	CONTROL_PLANE_CALLS,
+};
+
+// Times an entry point from construction to the end of the scope
+class control_plane_timer {
+public:
+	control_plane_timer(enum control_plane_call call, const char *source_name);
+	~control_plane_timer();
+
+private:
+	enum control_plane_call call;
+	std::string source_name;
+	uint64_t start_ns;
+};
+
+// Start the benchmark on its own thread, false if one is running
+bool control_plane_benchmark_start(uint32_t duration_sec, uint32_t interval_ms);
+
+// Stop a running benchmark and wait for it, without a report. Called on the UI thread.
+void control_plane_benchmark_stop();
+
+#endif // CONTROL_PLANE_H
@@ -0,0 +1,114 @@
+#include "flight-recorder.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+void flight_recorder_init(flight_recorder &recorder, size_t capacity)
+{
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	recorder.records.assign(capacity, flight_record());
+	recorder.records.shrink_to_fit();
+	recorder.next = 0;
+	recorder.count = 0;
+}
+
+void flight_recorder_add(flight_recorder &recorder, const flight_record &record)
+{
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	if (recorder.records.empty()) {
+		return;
+	}
+	recorder.records[recorder.next] = record;
+	recorder.next = (recorder.next + 1) % recorder.records.size();
+	if (recorder.count < recorder.records.size()) {
+		recorder.count++;
+	}
+}
+
+void flight_record_set_string(char *field, size_t field_size, const char *value)
+{
+	size_t len = std::min(strlen(value), field_size - 1);
+	// cut before a UTF-8 continuation byte, at the start of a code point
+	while (len > 0 && ((unsigned char)value[len] & 0xC0) == 0x80) {
+		len--;
+	}
+	memcpy(field, value, len);
+	field[len] = '\0';
+}
+
+// keep file names portable and the text on one line of the dump
+static std::string sanitize(const char *value, bool file_name)
+{
+	std::string result(value);
+	for (char &c : result) {
+		if (c == '\t' || c == '\n' || c == '\r' ||
+		    (file_name && (c == '/' || c == '\\' || c == ':' || c == '*' || c == '?' ||
+				   c == '"' || c == '<' || c == '>' || c == '|'))) {
+			c = '_';
+		}
+	}
+	return result;
+}
+
+std::string flight_recorder_dump(flight_recorder &recorder, const char *source_name,
+				 const char *reason)
+{
+	// copy out so recording is not blocked by the file I/O
+	std::vector<flight_record> records;
+	{
+		std::lock_guard<std::mutex> lock(recorder.mutex);
+		const size_t capacity = recorder.records.size();
+		records.reserve(recorder.count);
+		for (size_t i = 0; i < recorder.count; i++) {
+			records.push_back(
+				recorder.records[(recorder.next + capacity - recorder.count + i) %
+						 capacity]);
+		}
+	}
+	if (records.empty()) {
+		return "";
+	}
+
+	char *dir = obs_module_config_path("flight-recorder");
+	os_mkdirs(dir);
+	char time_str[32];
+	const time_t now = time(nullptr);
+	strftime(time_str, sizeof(time_str), "%Y-%m-%d_%H-%M-%S", localtime(&now));
+	const std::string path = std::string(dir) + "/" + sanitize(source_name, true) + "_" +
+				 time_str + ".tsv";
+	bfree(dir);
+
+	FILE *file = os_fopen(path.c_str(), "w");
+	if (file == nullptr) {
+		obs_log(LOG_ERROR, "Failed to write flight recorder dump %s", path.c_str());
+		return "";
+	}
+	fprintf(file, "# %s, %d segments, reason: %s\n", source_name, (int)records.size(),
+		reason);
+	fprintf(file, "wall_ms\taudio_ts_ms\tframes\toverlap_ms\tinput_queue_ms\t"
+		      "output_queue_ms\tadded_latency_ms\tdispatch_us\tresample_us\tvad_us\t"
+		      "inference_us\ttotal_us\tdecision\ttext\n");
+	const uint64_t first_ns = records.front().wall_ns;
+	for (const flight_record &r : records) {
+		fprintf(file,
+			"%.1f\t%.1f\t%" PRIu32 "\t%" PRIu32 "\t%" PRIu32 "\t%" PRIu32 "\t%" PRIu32
+			"\t%" PRIu32 "\t%" PRIu32 "\t%" PRIu32 "\t%" PRIu32 "\t%" PRIu32
+			"\t%s\t%s\n",
+			(double)(r.wall_ns - first_ns) / 1e6, (double)r.audio_timestamp / 1e6,
+			r.frames, r.overlap_ms, r.input_queue_ms, r.output_queue_ms,
+			r.added_latency_ms, r.dispatch_us, r.resample_us, r.vad_us, r.inference_us,
+			r.total_us, r.decision, sanitize(r.text, false).c_str());
+	}
+	fclose(file);
+
+	obs_log(LOG_INFO, "[%s] flight recorder: wrote %d segments to %s (%s)", source_name,
+		(int)records.size(), path.c_str(), reason);
+	return path;
+}
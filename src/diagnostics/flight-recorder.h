@@ -0,0 +1,59 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define FLIGHT_RECORD_DECISION_SIZE 12
+#define FLIGHT_RECORD_TEXT_SIZE 96
+
+// One analyzed segment. The layout is fixed so recording is a copy into a preallocated ring.
+struct flight_record {
+	// when the segment was committed to the output
+	uint64_t wall_ns;
+	// timestamp of the first frame of the segment
+	uint64_t audio_timestamp;
+	uint32_t frames;
+	uint32_t overlap_ms;
+	// audio waiting for analysis and for output after the segment was committed
+	uint32_t input_queue_ms;
+	uint32_t output_queue_ms;
+	// delay the filter added to the audio at the time
+	uint32_t added_latency_ms;
+	/* stage timings */
+	uint32_t dispatch_us;
+	uint32_t resample_us;
+	uint32_t vad_us;
+	uint32_t inference_us;
+	uint32_t total_us;
+	char decision[FLIGHT_RECORD_DECISION_SIZE];
+	// truncated transcription
+	char text[FLIGHT_RECORD_TEXT_SIZE];
+};
+
+struct flight_recorder {
+	std::mutex mutex;
+	std::vector<flight_record> records;
+	// index the next record is written to
+	size_t next = 0;
+	size_t count = 0;
+};
+
+// Allocate room for the given number of records and drop the recorded ones, 0 disables
+void flight_recorder_init(flight_recorder &recorder, size_t capacity);
+
+// Add a record, overwriting the oldest one when the ring is full
+void flight_recorder_add(flight_recorder &recorder, const flight_record &record);
+
+// Copy a UTF-8 string into a fixed size record field, truncating it at a code point
+void flight_record_set_string(char *field, size_t field_size, const char *value);
+
+// Write the records oldest first as tab separated text into the plugin config directory.
+// Returns the path of the file, or an empty string if nothing was written.
+std::string flight_recorder_dump(flight_recorder &recorder, const char *source_name,
+				 const char *reason);
+
+#endif // FLIGHT_RECORDER_H
@@ -0,0 +1,226 @@
+#include "session-report.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+
+#include <algorithm>
+#include <ctime>
+#include <iterator>
+
+static const double RTF_EDGES[SESSION_RTF_BUCKETS - 1] = {0.1, 0.2, 0.3, 0.5, 0.75, 1.0, 1.5, 2.0};
+static const uint64_t LATENCY_EDGES_MS[SESSION_LATENCY_BUCKETS - 1] = {250,  500,  1000, 1500,
+								       2000, 3000, 5000, 10000};
+
+void session_stats_add_segment(session_stats &stats, const session_segment &segment)
+{
+	const double rtf = segment.audio_sec > 0.0
+				   ? (double)segment.wall_ns / 1e9 / segment.audio_sec
+				   : 0.0;
+	const uint64_t latency_ms = segment.added_latency_ns / 1000000;
+	size_t rtf_bucket = 0;
+	while (rtf_bucket < SESSION_RTF_BUCKETS - 1 && rtf >= RTF_EDGES[rtf_bucket]) {
+		rtf_bucket++;
+	}
+	size_t latency_bucket = 0;
+	while (latency_bucket < SESSION_LATENCY_BUCKETS - 1 &&
+	       latency_ms >= LATENCY_EDGES_MS[latency_bucket]) {
+		latency_bucket++;
+	}
+
+	std::lock_guard<std::mutex> lock(stats.mutex);
+	stats.segments++;
+	stats.audio_sec += segment.audio_sec;
+	stats.cpu_ns += segment.cpu_ns;
+	stats.rtf_histogram[rtf_bucket]++;
+	stats.latency_histogram[latency_bucket]++;
+	stats.max_latency_ms = std::max(stats.max_latency_ms, latency_ms);
+	for (const std::string &decision : segment.decisions) {
+		stats.decisions[decision]++;
+	}
+	for (const std::string &detection : segment.detections) {
+		stats.detections[detection]++;
+	}
+	stats.vad_skipped += segment.vad_skipped ? 1 : 0;
+	stats.catchup_segments += segment.catchup ? 1 : 0;
+	stats.cuts += segment.cut ? 1 : 0;
+	stats.dropped_segments += segment.dropped ? 1 : 0;
+	stats.overlap_decreases += segment.overlap_change < 0 ? 1 : 0;
+	stats.overlap_increases += segment.overlap_change > 0 ? 1 : 0;
+}
+
+void session_stats_add_inference(session_stats &stats, double passes, bool early_stop)
+{
+	std::lock_guard<std::mutex> lock(stats.mutex);
+	stats.encoder_passes += passes;
+	stats.early_stops += early_stop ? 1 : 0;
+}
+
+void session_stats_add_skipped(session_stats &stats, double audio_sec)
+{
+	std::lock_guard<std::mutex> lock(stats.mutex);
+	stats.skipped_sec += audio_sec;
+}
+
+void session_stats_add_event(session_stats &stats, uint64_t timestamp, uint64_t duration_ns,
+			     const char *result, const std::string &text)
+{
+	std::lock_guard<std::mutex> lock(stats.mutex);
+	if (stats.events.size() < SESSION_MAX_EVENTS) {
+		stats.events.push_back({timestamp, duration_ns, result, text});
+	}
+}
+
+// The edit list, times in seconds since the start of the session
+static bool write_edit_list(const session_stats &stats, const std::string &path)
+{
+	FILE *file = os_fopen(path.c_str(), "w");
+	if (file == nullptr) {
+		return false;
+	}
+	fprintf(file, "start\tend\taction\ttext\n");
+	for (const session_event &event : stats.events) {
+		const uint64_t start_ns =
+			event.timestamp > stats.start_ns ? event.timestamp - stats.start_ns : 0;
+		fprintf(file, "%.3f\t%.3f\t%s\t%s\n", (double)start_ns / 1e9,
+			(double)(start_ns + event.duration_ns) / 1e9, event.result.c_str(),
+			event.text.c_str());
+	}
+	return fclose(file) == 0;
+}
+
+static obs_data_array_t *histogram_array(const uint64_t *histogram, size_t buckets,
+					 const char *edge_key, const double *edges)
+{
+	obs_data_array_t *array = obs_data_array_create();
+	for (size_t i = 0; i < buckets; i++) {
+		obs_data_t *bucket = obs_data_create();
+		if (i < buckets - 1) {
+			obs_data_set_double(bucket, edge_key, edges[i]);
+		}
+		obs_data_set_int(bucket, "count", (long long)histogram[i]);
+		obs_data_array_push_back(array, bucket);
+		obs_data_release(bucket);
+	}
+	return array;
+}
+
+static obs_data_t *counts_object(const std::map<std::string, uint64_t> &counts)
+{
+	obs_data_t *object = obs_data_create();
+	for (const auto &count : counts) {
+		obs_data_set_int(object, count.first.c_str(), (long long)count.second);
+	}
+	return object;
+}
+
+void session_report_write(session_stats &stats, const char *source_name, const char *reason)
+{
+	std::lock_guard<std::mutex> lock(stats.mutex);
+	const uint64_t now = os_gettime_ns();
+	const uint64_t fail_open_events = stats.fail_open_events.exchange(0);
+	const uint64_t fail_open_ns = stats.fail_open_ns.exchange(0);
+	const uint64_t silence_ns = stats.silence_passthrough_ns.exchange(0);
+	const uint64_t underruns = stats.underruns.exchange(0);
+
+	if (stats.segments > 0) {
+		obs_data_t *report = obs_data_create();
+		obs_data_set_string(report, "source", source_name);
+		obs_data_set_string(report, "reason", reason);
+		obs_data_set_double(report, "session_sec", (double)(now - stats.start_ns) / 1e9);
+		obs_data_set_double(report, "audio_sec", stats.audio_sec);
+		obs_data_set_double(report, "cpu_sec", (double)stats.cpu_ns / 1e9);
+		obs_data_set_int(report, "segments", (long long)stats.segments);
+		obs_data_set_double(report, "vad_skip_rate",
+				    (double)stats.vad_skipped / (double)stats.segments);
+		obs_data_set_double(report, "encoder_passes", stats.encoder_passes);
+		obs_data_set_int(report, "early_stops", (long long)stats.early_stops);
+		obs_data_set_double(report, "silence_passthrough_sec", (double)silence_ns / 1e9);
+
+		double latency_edges[SESSION_LATENCY_BUCKETS - 1];
+		for (size_t i = 0; i < SESSION_LATENCY_BUCKETS - 1; i++) {
+			latency_edges[i] = (double)LATENCY_EDGES_MS[i];
+		}
+		obs_data_array_t *rtf = histogram_array(stats.rtf_histogram, SESSION_RTF_BUCKETS,
+							"below", RTF_EDGES);
+		obs_data_array_t *latency = histogram_array(stats.latency_histogram,
+							    SESSION_LATENCY_BUCKETS, "below_ms",
+							    latency_edges);
+		obs_data_set_array(report, "rtf_histogram", rtf);
+		obs_data_set_array(report, "added_latency_histogram", latency);
+		obs_data_array_release(rtf);
+		obs_data_array_release(latency);
+		obs_data_set_int(report, "max_added_latency_ms", (long long)stats.max_latency_ms);
+
+		obs_data_set_int(report, "fail_open_events", (long long)fail_open_events);
+		obs_data_set_double(report, "fail_open_sec", (double)fail_open_ns / 1e9);
+		obs_data_set_int(report, "dropped_segments", (long long)stats.dropped_segments);
+		obs_data_set_int(report, "underruns", (long long)underruns);
+
+		obs_data_set_int(report, "overlap_decreases", (long long)stats.overlap_decreases);
+		obs_data_set_int(report, "overlap_increases", (long long)stats.overlap_increases);
+		obs_data_set_int(report, "catchup_segments", (long long)stats.catchup_segments);
+		obs_data_set_int(report, "cuts", (long long)stats.cuts);
+		obs_data_set_double(report, "skipped_sec", stats.skipped_sec);
+
+		obs_data_t *decisions = counts_object(stats.decisions);
+		obs_data_t *detections = counts_object(stats.detections);
+		obs_data_set_obj(report, "decisions", decisions);
+		obs_data_set_obj(report, "detections", detections);
+		obs_data_release(decisions);
+		obs_data_release(detections);
+
+		char *dir = obs_module_config_path("reports");
+		os_mkdirs(dir);
+		char time_str[32];
+		const time_t wall_time = time(nullptr);
+		strftime(time_str, sizeof(time_str), "%Y-%m-%d_%H-%M-%S", localtime(&wall_time));
+		std::string name = source_name;
+		for (char &c : name) {
+			if (c == '/' || c == '\\' || c == ':' || c == '*' || c == '?' || c == '"' ||
+			    c == '<' || c == '>' || c == '|') {
+				c = '_';
+			}
+		}
+		const std::string base = std::string(dir) + "/" + name + "_" + time_str;
+		const std::string path = base + ".json";
+		bfree(dir);
+		if (!stats.events.empty()) {
+			const std::string edit_list_path = base + ".tsv";
+			obs_data_set_string(report, "edit_list", edit_list_path.c_str());
+			if (!write_edit_list(stats, edit_list_path)) {
+				obs_log(LOG_WARNING, "Failed to write edit list %s",
+					edit_list_path.c_str());
+			}
+		}
+		if (obs_data_save_json(report, path.c_str())) {
+			obs_log(LOG_INFO, "[%s] session report (%s): %.0f s of audio, %.1f cpu s, %s",
+				source_name, reason, stats.audio_sec, (double)stats.cpu_ns / 1e9,
+				path.c_str());
+		} else {
+			obs_log(LOG_WARNING, "Failed to write session report %s", path.c_str());
+		}
+		obs_data_release(report);
+	}
+
+	// start a new session
+	stats.start_ns = now;
+	stats.segments = 0;
+	stats.audio_sec = 0.0;
+	stats.cpu_ns = 0;
+	stats.vad_skipped = 0;
+	stats.encoder_passes = 0.0;
+	stats.early_stops = 0;
+	std::fill(std::begin(stats.rtf_histogram), std::end(stats.rtf_histogram), 0);
+	std::fill(std::begin(stats.latency_histogram), std::end(stats.latency_histogram), 0);
+	stats.max_latency_ms = 0;
+	stats.decisions.clear();
+	stats.detections.clear();
+	stats.overlap_decreases = 0;
+	stats.overlap_increases = 0;
+	stats.catchup_segments = 0;
+	stats.cuts = 0;
+	stats.dropped_segments = 0;
+	stats.skipped_sec = 0.0;
+	stats.events.clear();
+}
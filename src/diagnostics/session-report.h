@@ -0,0 +1,104 @@
+#ifndef SESSION_REPORT_H
+#define SESSION_REPORT_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// real time factor buckets: < 0.1, 0.2, 0.3, 0.5, 0.75, 1, 1.5, 2, >= 2
+#define SESSION_RTF_BUCKETS 9
+// added latency buckets in ms: < 250, 500, 1000, 1500, 2000, 3000, 5000, 10000, >= 10000
+#define SESSION_LATENCY_BUCKETS 9
+// detections kept for the edit list of a report
+#define SESSION_MAX_EVENTS 100000
+
+// A detection in analysis only mode, written to the edit list of the report
+struct session_event {
+	// audio timestamp and length of the segment
+	uint64_t timestamp;
+	uint64_t duration_ns;
+	std::string result;
+	std::string text;
+};
+
+// Performance counters of a filter between two reports
+struct session_stats {
+	std::mutex mutex;
+	uint64_t start_ns = 0;
+
+	/* per analyzed segment, protected by mutex */
+	uint64_t segments = 0;
+	double audio_sec = 0.0;
+	// CPU time of the process while segments were analyzed, with whisper's compute threads
+	// but also the rest of OBS and other filters analyzing at the same time
+	uint64_t cpu_ns = 0;
+	uint64_t vad_skipped = 0;
+	// whisper calls, a call packed with the segments of other filters counts in part
+	double encoder_passes = 0.0;
+	// transcriptions ended as soon as the rules decided them
+	uint64_t early_stops = 0;
+	uint64_t rtf_histogram[SESSION_RTF_BUCKETS] = {};
+	uint64_t latency_histogram[SESSION_LATENCY_BUCKETS] = {};
+	uint64_t max_latency_ms = 0;
+	// decisions by result name and detections by the matched text of the rules
+	std::map<std::string, uint64_t> decisions;
+	std::map<std::string, uint64_t> detections;
+	// overlap reductions and increases after slow and fast segments
+	uint64_t overlap_decreases = 0;
+	uint64_t overlap_increases = 0;
+	uint64_t catchup_segments = 0;
+	uint64_t cuts = 0;
+	uint64_t dropped_segments = 0;
+	// audio not analyzed in analysis only mode because the analysis fell behind
+	double skipped_sec = 0.0;
+	std::vector<session_event> events;
+
+	/* from the audio thread */
+	// audio passed through unfiltered because the model was not loaded
+	std::atomic<uint64_t> fail_open_events{0};
+	std::atomic<uint64_t> fail_open_ns{0};
+	std::atomic<uint64_t> silence_passthrough_ns{0};
+	std::atomic<uint64_t> underruns{0};
+};
+
+// An analyzed segment, filled in while it is processed and recorded at once
+struct session_segment {
+	double audio_sec = 0.0;
+	uint64_t wall_ns = 0;
+	uint64_t cpu_ns = 0;
+	uint64_t added_latency_ns = 0;
+	// result names of the transcribed channels and the texts the rules matched in them
+	std::vector<std::string> decisions;
+	std::vector<std::string> detections;
+	bool vad_skipped = false;
+	bool catchup = false;
+	bool cut = false;
+	// not output, the buffers were reset while it was processed
+	bool dropped = false;
+	// the overlap was reduced (-1) or increased (1) after it
+	int overlap_change = 0;
+};
+
+// Record an analyzed segment
+void session_stats_add_segment(session_stats &stats, const session_segment &segment);
+
+// Record a whisper call, passes is the segment's share of a call packed with other segments
+void session_stats_add_inference(session_stats &stats, double passes, bool early_stop);
+
+// Record audio skipped in analysis only mode
+void session_stats_add_skipped(session_stats &stats, double audio_sec);
+
+// Record a detection for the edit list, once SESSION_MAX_EVENTS are recorded the rest are
+// only counted
+void session_stats_add_event(session_stats &stats, uint64_t timestamp, uint64_t duration_ns,
+			     const char *result, const std::string &text);
+
+// Write the report into the plugin config directory and start a new session. The detections
+// recorded with session_stats_add_event go into a tab separated edit list next to it.
+// Nothing is written if no audio was analyzed.
+void session_report_write(session_stats &stats, const char *source_name, const char *reason);
+
+#endif // SESSION_REPORT_H
@@ -0,0 +1,32 @@
+#ifndef TRACEPOINTS_H
+#define TRACEPOINTS_H
+
+// Static user-level tracepoints (USDT) in the provider "cleanstream", for perf and bpftrace:
+//   bpftrace -e 'usdt:/path/to/obs-cleanstream.so:cleanstream:inference_end { ... }'
+// A tracepoint is a single nop until a tracer attaches to it. Without sys/sdt.h they compile
+// to nothing.
+//
+//   audio_in(frames, timestamp)               a packet entered cleanstream_filter_audio
+//   audio_out(frames, timestamp, latency_ns)  a packet left it, after the delay
+//   fail_open(frames)                         a packet passed through without a model
+//   segment_pop(frames, timestamp)            a segment was taken from the input buffer
+//   resample(frames, duration_ns)             the segment was resampled to 16 kHz
+//   vad(speech, energy_micro, duration_ns)    the VAD decision, energy in millionths
+//   inference_begin(samples)
+//   inference_end(result, duration_ns)
+//   detection(result, text, matched)          the detection result with the transcription
+//   overlap_change(old_ms, new_ms)
+//   control_plane(call, duration_ns)          create (0), update (1) or destroy (2) returned
+
+#if defined(HAVE_SYS_SDT_H)
+#include <sys/sdt.h>
+#define CLEANSTREAM_TRACE1(name, a) DTRACE_PROBE1(cleanstream, name, a)
+#define CLEANSTREAM_TRACE2(name, a, b) DTRACE_PROBE2(cleanstream, name, a, b)
+#define CLEANSTREAM_TRACE3(name, a, b, c) DTRACE_PROBE3(cleanstream, name, a, b, c)
+#else
+#define CLEANSTREAM_TRACE1(name, a)
+#define CLEANSTREAM_TRACE2(name, a, b)
+#define CLEANSTREAM_TRACE3(name, a, b, c)
+#endif
+
+#endif // TRACEPOINTS_H
@@ -0,0 +1,141 @@
+#include "model-catalog.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+
+#include <map>
+#include <mutex>
+
+#define CATALOG_VERSION 1
+#define MEASUREMENTS_FILE "model-speed.json"
+
+static std::once_flag catalog_once;
+static std::vector<model_info> catalog;
+
+static std::mutex measurements_mutex;
+static std::map<std::string, double> measurements;
+static bool measurements_dirty = false;
+
+static void load_catalog()
+{
+	char *catalog_file = obs_module_file("models/catalog.json");
+	obs_data_t *data = catalog_file ? obs_data_create_from_json_file(catalog_file) : nullptr;
+	bfree(catalog_file);
+	if (data == nullptr) {
+		obs_log(LOG_ERROR, "Failed to read the model catalog");
+		return;
+	}
+
+	const long long version = obs_data_get_int(data, "version");
+	if (version > CATALOG_VERSION) {
+		obs_log(LOG_WARNING, "Model catalog version %lld is newer than supported (%d)",
+			version, CATALOG_VERSION);
+	}
+
+	obs_data_array_t *models = obs_data_get_array(data, "models");
+	const size_t count = obs_data_array_count(models);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_array_item(models, i);
+		model_info info;
+		info.name = obs_data_get_string(item, "name");
+		info.file = obs_data_get_string(item, "file");
+		info.url = obs_data_get_string(item, "url");
+		info.size = (uint64_t)obs_data_get_int(item, "size");
+		info.sha256 = obs_data_get_string(item, "sha256");
+		info.language = obs_data_get_string(item, "language");
+		info.quantization = obs_data_get_string(item, "quantization");
+		info.reference_rtf = obs_data_get_double(item, "reference_rtf");
+		obs_data_release(item);
+		if (!info.file.empty()) {
+			catalog.push_back(info);
+		}
+	}
+	obs_data_array_release(models);
+	obs_data_release(data);
+
+	// speed measured in earlier sessions
+	char *measurements_file = obs_module_config_path(MEASUREMENTS_FILE);
+	obs_data_t *measured = obs_data_create_from_json_file_safe(measurements_file, "bak");
+	bfree(measurements_file);
+	if (measured != nullptr) {
+		std::lock_guard<std::mutex> lock(measurements_mutex);
+		for (const model_info &info : catalog) {
+			const double rtf = obs_data_get_double(measured, info.file.c_str());
+			if (rtf > 0.0 && measurements.count(info.file) == 0) {
+				measurements[info.file] = rtf;
+			}
+		}
+		obs_data_release(measured);
+	}
+}
+
+std::vector<model_info> get_model_catalog()
+{
+	std::call_once(catalog_once, load_catalog);
+
+	std::vector<model_info> models = catalog;
+	std::lock_guard<std::mutex> lock(measurements_mutex);
+	for (model_info &info : models) {
+		auto it = measurements.find(info.file);
+		if (it != measurements.end()) {
+			info.measured_rtf = it->second;
+		}
+	}
+	return models;
+}
+
+bool find_model_info(const std::string &file, model_info &info)
+{
+	for (const model_info &model : get_model_catalog()) {
+		if (model.file == file) {
+			info = model;
+			return true;
+		}
+	}
+	return false;
+}
+
+double model_expected_rtf(const model_info &info)
+{
+	return info.measured_rtf > 0.0 ? info.measured_rtf : info.reference_rtf;
+}
+
+void model_catalog_record_rtf(const std::string &file, double rtf)
+{
+	if (rtf <= 0.0) {
+		return;
+	}
+	std::call_once(catalog_once, load_catalog);
+
+	// the latest calibration replaces the earlier ones, the machine or its load may have
+	// changed since
+	std::lock_guard<std::mutex> lock(measurements_mutex);
+	measurements[file] = rtf;
+	measurements_dirty = true;
+}
+
+void model_catalog_save_measurements()
+{
+	std::lock_guard<std::mutex> lock(measurements_mutex);
+	if (!measurements_dirty) {
+		return;
+	}
+
+	char *config_dir = obs_module_config_path("");
+	os_mkdirs(config_dir);
+	bfree(config_dir);
+
+	obs_data_t *data = obs_data_create();
+	for (const auto &measurement : measurements) {
+		obs_data_set_double(data, measurement.first.c_str(), measurement.second);
+	}
+	char *measurements_file = obs_module_config_path(MEASUREMENTS_FILE);
+	if (obs_data_save_json_safe(data, measurements_file, "tmp", "bak")) {
+		measurements_dirty = false;
+	} else {
+		obs_log(LOG_WARNING, "Failed to save %s", measurements_file);
+	}
+	bfree(measurements_file);
+	obs_data_release(data);
+}
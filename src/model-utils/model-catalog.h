@@ -0,0 +1,41 @@
+#ifndef MODEL_CATALOG_H
+#define MODEL_CATALOG_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// An entry of the model catalog in data/models/catalog.json
+struct model_info {
+	std::string name;
+	// model name as used in the settings, e.g. "models/ggml-tiny.en.bin"
+	std::string file;
+	std::string url;
+	// 0 and empty when unknown
+	uint64_t size = 0;
+	std::string sha256;
+	std::string language;
+	std::string quantization;
+	// real time factor (processing time / audio time) on the reference machine
+	double reference_rtf = 0.0;
+	// real time factor of a full window measured on this machine, 0 if the model was never
+	// calibrated here
+	double measured_rtf = 0.0;
+};
+
+// The catalog with the speed measured on this machine merged in, in catalog order
+std::vector<model_info> get_model_catalog();
+
+// Look up a catalog entry by model name, returns false if the model is not in the catalog
+bool find_model_info(const std::string &file, model_info &info);
+
+// Best known real time factor: measured on this machine, else the reference, 0 if unknown
+double model_expected_rtf(const model_info &info);
+
+// Record the real time factor of a calibration run with the given model
+void model_catalog_record_rtf(const std::string &file, double rtf);
+
+// Write the measured speeds to the plugin config directory
+void model_catalog_save_measurements();
+
+#endif // MODEL_CATALOG_H
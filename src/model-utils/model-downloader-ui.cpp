@@ -1,10 +1,11 @@
 #include "model-downloader-ui.h"
+#include "model-catalog.h"
+#include "model-store.h"
 #include "plugin-support.h"
 
 #include <obs-module.h>
 
-const std::string MODEL_BASE_PATH = "https://huggingface.co/ggerganov/whisper.cpp";
-const std::string MODEL_PREFIX = "resolve/main/";
+#include <cctype>
 
 size_t write_data(void *ptr, size_t size, size_t nmemb, FILE *stream)
 {
@@ -12,6 +13,34 @@ size_t write_data(void *ptr, size_t size, size_t nmemb, FILE *stream)
 	return written;
 }
 
+// Hugging Face sends the SHA-256 of a file stored with git LFS in the X-Linked-Etag header of
+// the response redirecting to the download, e.g. X-Linked-Etag: "921e4c..."
+static size_t read_linked_etag(char *buffer, size_t size, size_t nitems, std::string *sha256)
+{
+	const size_t length = size * nitems;
+	const std::string header(buffer, length);
+	const std::string name = "x-linked-etag:";
+	if (length > name.size() && sha256->empty()) {
+		std::string prefix = header.substr(0, name.size());
+		for (char &c : prefix) {
+			c = (char)tolower((unsigned char)c);
+		}
+		if (prefix == name) {
+			std::string value;
+			for (size_t i = name.size(); i < length; i++) {
+				if (isxdigit((unsigned char)header[i])) {
+					value += (char)tolower((unsigned char)header[i]);
+				}
+			}
+			// the etag of a file stored without LFS is a git hash, not a SHA-256
+			if (value.size() == 64) {
+				*sha256 = value;
+			}
+		}
+	}
+	return length;
+}
+
 ModelDownloader::ModelDownloader(
 	const std::string &model_name,
 	std::function<void(int download_status)> download_finished_callback_, QWidget *parent)
@@ -106,18 +135,25 @@ ModelDownloadWorker::ModelDownloadWorker(const std::string &model_name_)
 
 void ModelDownloadWorker::download_model()
 {
-	std::string module_data_dir = obs_get_module_data_path(obs_current_module());
-	// join the directory and the filename using the platform-specific separator
-	std::string model_save_path = module_data_dir + "/" + this->model_name;
+	// download next to the model store, the file is moved into it once complete
+	std::string model_save_path = model_store_download_path(this->model_name);
 	obs_log(LOG_INFO, "Model save path: %s", model_save_path.c_str());
 
-	// extract filename from path in this->modle_name
-	const std::string model_filename =
-		this->model_name.substr(this->model_name.find_last_of("/\\") + 1);
-
-	std::string model_url = MODEL_BASE_PATH + "/" + MODEL_PREFIX + model_filename;
+	std::string model_url = model_download_url(this->model_name);
 	obs_log(LOG_INFO, "Model URL: %s", model_url.c_str());
 
+	model_info info;
+	if (!find_model_info(this->model_name, info)) {
+		obs_log(LOG_WARNING, "Model %s is not in the catalog, it cannot be verified",
+			this->model_name.c_str());
+	}
+	if (!model_store_has_space(info.size)) {
+		obs_log(LOG_ERROR, "Not enough disk space for model %s (%llu bytes).",
+			this->model_name.c_str(), (unsigned long long)info.size);
+		emit download_error("Not enough disk space.");
+		return;
+	}
+
 	CURL *curl = curl_easy_init();
 	if (curl) {
 		FILE *fp = fopen(model_save_path.c_str(), "wb");
@@ -126,9 +162,13 @@ void ModelDownloadWorker::download_model()
 			emit download_error("Failed to open file.");
 			return;
 		}
+		model_store_preallocate(fp, info.size);
 		curl_easy_setopt(curl, CURLOPT_URL, model_url.c_str());
 		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
+		std::string published_sha256;
+		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, read_linked_etag);
+		curl_easy_setopt(curl, CURLOPT_HEADERDATA, &published_sha256);
 		curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
 		curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION,
 				 ModelDownloadWorker::progress_callback);
@@ -136,13 +176,29 @@ void ModelDownloadWorker::download_model()
 		// Follow redirects
 		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
 		CURLcode res = curl_easy_perform(curl);
+		curl_easy_cleanup(curl);
+		fclose(fp);
 		if (res != CURLE_OK) {
 			obs_log(LOG_ERROR, "Failed to download model %s.",
 				this->model_name.c_str());
+			remove(model_save_path.c_str());
 			emit download_error("Failed to download model.");
+			return;
+		}
+		// the catalog lists the hashes it was released with, for the other models the
+		// hash the server published is checked
+		std::string expected_sha256 = info.sha256;
+		if (expected_sha256.empty()) {
+			expected_sha256 = published_sha256;
+		}
+		if (expected_sha256.empty()) {
+			obs_log(LOG_WARNING, "No SHA-256 known for model %s, it is not verified",
+				this->model_name.c_str());
+		}
+		if (!model_store_add(this->model_name, model_save_path, expected_sha256)) {
+			emit download_error("Failed to store model.");
+			return;
 		}
-		curl_easy_cleanup(curl);
-		fclose(fp);
 	} else {
 		obs_log(LOG_ERROR, "Failed to initialize curl.");
 		emit download_error("Failed to initialize curl.");
@@ -1,4 +1,5 @@
 #include "model-downloader.h"
+#include "model-store.h"
 #include "plugin-support.h"
 #include "model-downloader-ui.h"
 
@@ -15,19 +16,12 @@
 bool check_if_model_exists(const std::string &model_name)
 {
 	obs_log(LOG_INFO, "Checking if model %s exists...", model_name.c_str());
-	char *model_file_path = obs_module_file(model_name.c_str());
-	obs_log(LOG_INFO, "Model file path: %s", model_file_path);
-	if (model_file_path == nullptr) {
+	const std::string model_file_path = find_model_file(model_name);
+	if (model_file_path.empty()) {
 		obs_log(LOG_INFO, "Model %s does not exist.", model_name.c_str());
 		return false;
 	}
-
-	if (!std::filesystem::exists(model_file_path)) {
-		obs_log(LOG_INFO, "Model %s does not exist.", model_file_path);
-		bfree(model_file_path);
-		return false;
-	}
-	bfree(model_file_path);
+	obs_log(LOG_INFO, "Model file path: %s", model_file_path.c_str());
 	return true;
 }
 
@@ -0,0 +1,311 @@
+#include "model-store.h"
+#include "model-catalog.h"
+#include "sha256.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+const std::string MODEL_BASE_PATH = "https://huggingface.co/ggerganov/whisper.cpp";
+const std::string MODEL_PREFIX = "resolve/main/";
+
+// Other local Whisper plugins whose downloaded models can be reused
+static const char *const OTHER_WHISPER_PLUGINS[] = {"obs-localvocal", "obs-polyglot"};
+
+static std::string model_file_name(const std::string &model_name)
+{
+	return model_name.substr(model_name.find_last_of("/\\") + 1);
+}
+
+static fs::path to_path(const std::string &utf8)
+{
+	return fs::u8path(utf8);
+}
+
+static std::string from_path(const fs::path &path)
+{
+	return path.u8string();
+}
+
+// A name part unique to this download or write, filters and OBS instances may fetch the same
+// model at the same time
+static std::string unique_suffix()
+{
+	static std::atomic<unsigned> counter{0};
+#ifdef _WIN32
+	const unsigned long pid = GetCurrentProcessId();
+#else
+	const unsigned long pid = (unsigned long)getpid();
+#endif
+	return std::to_string(pid) + "-" + std::to_string(counter++);
+}
+
+static std::string getenv_string(const char *name)
+{
+	const char *value = getenv(name);
+	return value == nullptr ? "" : value;
+}
+
+std::string model_store_dir()
+{
+#ifdef _WIN32
+	fs::path base = to_path(getenv_string("LOCALAPPDATA"));
+#elif defined(__APPLE__)
+	fs::path base = to_path(getenv_string("HOME")) / "Library" / "Caches";
+#else
+	fs::path base = to_path(getenv_string("XDG_CACHE_HOME"));
+	if (base.empty()) {
+		base = to_path(getenv_string("HOME")) / ".cache";
+	}
+#endif
+	return from_path(base / "obs-ai-models");
+}
+
+static fs::path ref_path(const std::string &model_name)
+{
+	return to_path(model_store_dir()) / "refs" / model_file_name(model_name);
+}
+
+static fs::path blob_path(const std::string &sha256)
+{
+	return to_path(model_store_dir()) / "blobs" / "sha256" / sha256;
+}
+
+static std::string find_in_store(const std::string &model_name)
+{
+	std::ifstream ref(ref_path(model_name));
+	std::string sha256;
+	if (!ref.is_open() || !std::getline(ref, sha256) || sha256.empty()) {
+		return "";
+	}
+	std::error_code ec;
+	const fs::path blob = blob_path(sha256);
+	return fs::is_regular_file(blob, ec) ? from_path(blob) : "";
+}
+
+// Model files of other plugins by file name, with the plugin that downloaded them. The
+// directories are scanned once per session, model lookups run on the UI thread.
+static std::once_flag other_plugins_once;
+static std::map<std::string, std::pair<std::string, const char *>> other_plugin_models;
+
+static void index_dir(const fs::path &dir, const char *plugin)
+{
+	std::error_code ec;
+	if (!fs::is_directory(dir, ec)) {
+		return;
+	}
+	// plugins keep models either directly in the directory or in a folder per model
+	for (auto it = fs::recursive_directory_iterator(dir, ec);
+	     !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+		if (it.depth() > 1) {
+			it.disable_recursion_pending();
+		}
+		if (it->is_regular_file(ec)) {
+			other_plugin_models.emplace(from_path(it->path().filename()),
+						    std::make_pair(from_path(it->path()), plugin));
+		}
+	}
+}
+
+static void index_other_plugins()
+{
+	// plugin data directories are siblings of ours, as are the plugin config directories
+	const fs::path data_dir = to_path(obs_get_module_data_path(obs_current_module()));
+	char *config_file = obs_module_config_path("");
+	const fs::path config_dir = to_path(config_file != nullptr ? config_file : "");
+	bfree(config_file);
+
+	for (const char *plugin : OTHER_WHISPER_PLUGINS) {
+		for (const fs::path &dir : {data_dir.parent_path() / plugin / "models",
+					    config_dir.parent_path().parent_path() / plugin / "models"}) {
+			index_dir(dir, plugin);
+		}
+	}
+}
+
+static std::string find_in_other_plugins(const std::string &model_name)
+{
+	std::call_once(other_plugins_once, index_other_plugins);
+
+	auto it = other_plugin_models.find(model_file_name(model_name));
+	if (it == other_plugin_models.end()) {
+		return "";
+	}
+	// the other plugin may have deleted it since the scan
+	std::error_code ec;
+	const std::string &found = it->second.first;
+	if (!fs::is_regular_file(to_path(found), ec)) {
+		return "";
+	}
+	obs_log(LOG_INFO, "Reusing model %s downloaded by %s", found.c_str(), it->second.second);
+	return found;
+}
+
+std::string find_model_file(const std::string &model_name)
+{
+	// bundled with the plugin, or downloaded by an older version into the plugin data
+	char *module_file = obs_module_file(model_name.c_str());
+	if (module_file != nullptr) {
+		std::string path = module_file;
+		bfree(module_file);
+		std::error_code ec;
+		if (fs::is_regular_file(to_path(path), ec)) {
+			return path;
+		}
+	}
+
+	std::string path = find_in_store(model_name);
+	if (path.empty()) {
+		path = find_in_other_plugins(model_name);
+	}
+	return path;
+}
+
+std::string model_download_url(const std::string &model_name)
+{
+	const std::string file_name = model_file_name(model_name);
+	std::string mirror = getenv_string("OBS_AI_MODEL_MIRROR");
+	if (mirror.empty()) {
+		model_info info;
+		if (find_model_info(model_name, info) && !info.url.empty()) {
+			return info.url;
+		}
+		return MODEL_BASE_PATH + "/" + MODEL_PREFIX + file_name;
+	}
+
+	while (!mirror.empty() && (mirror.back() == '/' || mirror.back() == '\\')) {
+		mirror.pop_back();
+	}
+	if (mirror.rfind("http://", 0) == 0 || mirror.rfind("https://", 0) == 0 ||
+	    mirror.rfind("file://", 0) == 0) {
+		return mirror + "/" + file_name;
+	}
+
+	// a local directory, curl reads it through a file:// URL
+	std::error_code ec;
+	std::string dir = fs::absolute(to_path(mirror), ec).generic_u8string();
+	if (dir.empty() || dir[0] != '/') {
+		dir = "/" + dir;
+	}
+	return "file://" + dir + "/" + file_name;
+}
+
+std::string model_store_download_path(const std::string &model_name)
+{
+	const fs::path tmp_dir = to_path(model_store_dir()) / "tmp";
+	std::error_code ec;
+	fs::create_directories(tmp_dir, ec);
+	return from_path(tmp_dir /
+			 (model_file_name(model_name) + "." + unique_suffix() + ".part"));
+}
+
+bool model_store_has_space(uint64_t size)
+{
+	std::error_code ec;
+	const fs::space_info space = fs::space(to_path(model_store_dir()), ec);
+	if (ec) {
+		// let the download try, it fails on its own if the disk is full
+		obs_log(LOG_WARNING, "Failed to get the free space for the model store: %s",
+			ec.message().c_str());
+		return true;
+	}
+	// keep some room for everything else on the disk
+	return space.available > size + size / 10;
+}
+
+void model_store_preallocate(FILE *fp, uint64_t size)
+{
+	if (size == 0) {
+		return;
+	}
+	// reserve the blocks without changing the file size, so a short download is still
+	// detected and the file does not end up fragmented
+#if defined(_WIN32)
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno(fp));
+	FILE_ALLOCATION_INFO allocation;
+	allocation.AllocationSize.QuadPart = (LONGLONG)size;
+	SetFileInformationByHandle(file, FileAllocationInfo, &allocation, sizeof(allocation));
+#elif defined(__APPLE__)
+	fstore_t store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, (off_t)size, 0};
+	if (fcntl(fileno(fp), F_PREALLOCATE, &store) == -1) {
+		store.fst_flags = F_ALLOCATEALL;
+		fcntl(fileno(fp), F_PREALLOCATE, &store);
+	}
+#elif defined(__linux__)
+	fallocate(fileno(fp), FALLOC_FL_KEEP_SIZE, 0, (off_t)size);
+#else
+	UNUSED_PARAMETER(fp);
+#endif
+}
+
+bool model_store_add(const std::string &model_name, const std::string &file_path,
+		     const std::string &expected_sha256)
+{
+	std::error_code ec;
+	const std::string sha256 = sha256_file(file_path);
+	if (sha256.empty()) {
+		obs_log(LOG_ERROR, "Failed to read %s", file_path.c_str());
+		return false;
+	}
+	if (!expected_sha256.empty() && sha256 != expected_sha256) {
+		obs_log(LOG_ERROR, "Model %s has SHA-256 %s, expected %s", model_name.c_str(),
+			sha256.c_str(), expected_sha256.c_str());
+		fs::remove(to_path(file_path), ec);
+		return false;
+	}
+
+	const fs::path blob = blob_path(sha256);
+	fs::create_directories(blob.parent_path(), ec);
+	if (fs::is_regular_file(blob, ec)) {
+		// identical weights are already stored, e.g. under another name
+		fs::remove(to_path(file_path), ec);
+	} else {
+		fs::rename(to_path(file_path), blob, ec);
+		if (ec) {
+			obs_log(LOG_ERROR, "Failed to move %s to the model store: %s",
+				file_path.c_str(), ec.message().c_str());
+			return false;
+		}
+	}
+
+	// write the ref next to its final name and rename it, readers never see a partial ref
+	const fs::path ref = ref_path(model_name);
+	fs::create_directories(ref.parent_path(), ec);
+	fs::path ref_tmp = ref;
+	ref_tmp += "." + unique_suffix() + ".tmp";
+	{
+		std::ofstream out(ref_tmp, std::ios::trunc);
+		out << sha256 << std::endl;
+		if (!out) {
+			obs_log(LOG_ERROR, "Failed to write %s", from_path(ref_tmp).c_str());
+			return false;
+		}
+	}
+	fs::rename(ref_tmp, ref, ec);
+	if (ec) {
+		obs_log(LOG_ERROR, "Failed to write %s: %s", from_path(ref).c_str(),
+			ec.message().c_str());
+		return false;
+	}
+
+	obs_log(LOG_INFO, "Stored model %s as %s", model_name.c_str(), from_path(blob).c_str());
+	return true;
+}
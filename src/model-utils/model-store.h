@@ -0,0 +1,41 @@
+#ifndef MODEL_STORE_H
+#define MODEL_STORE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Content addressed model store in a per-user cache directory shared by all OBS profiles,
+// portable installs and plugins using it:
+//   <store>/blobs/sha256/<hash>   the model files, stored once per content
+//   <store>/refs/<file name>      the hash a model file name currently points to
+
+// The store directory, e.g. ~/.cache/obs-ai-models
+std::string model_store_dir();
+
+// Find a local copy of a model like "models/ggml-small.en.bin": bundled with the plugin,
+// in the model store or downloaded by another local Whisper plugin. The models of other
+// plugins are looked up in a list made on the first call.
+// Returns the absolute path, or an empty string if there is none.
+std::string find_model_file(const std::string &model_name);
+
+// Where to download a model from, as listed in the model catalog. Set OBS_AI_MODEL_MIRROR to an http(s):// or file:// base
+// URL, or to a local directory, to download from a mirror instead of Hugging Face.
+std::string model_download_url(const std::string &model_name);
+
+// A new file to download a model to before it is added to the store, every call returns
+// another one
+std::string model_store_download_path(const std::string &model_name);
+
+// Whether the store has room for a model of the given size, true if that cannot be told
+bool model_store_has_space(uint64_t size);
+
+// Reserve disk space for a download of the given size, best effort
+void model_store_preallocate(FILE *fp, uint64_t size);
+
+// Move a downloaded file into the store under its content hash and point the model name at
+// it. If expected_sha256 is not empty the file is rejected when it does not match.
+bool model_store_add(const std::string &model_name, const std::string &file_path,
+		     const std::string &expected_sha256 = "");
+
+#endif // MODEL_STORE_H
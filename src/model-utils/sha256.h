@@ -0,0 +1,28 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Incremental SHA-256, used to address model files by content
+class Sha256 {
+public:
+	Sha256();
+	void update(const void *data, size_t size);
+	// Returns the lowercase hex digest, the object must not be updated afterwards
+	std::string finish();
+
+private:
+	void transform(const uint8_t *block);
+
+	uint32_t state[8];
+	uint8_t buffer[64];
+	size_t buffer_size;
+	uint64_t total_size;
+};
+
+// Hash a file, returns an empty string if it cannot be read
+std::string sha256_file(const std::string &path);
+
+#endif // SHA256_H
@@ -19,6 +19,8 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <obs-module.h>
 #include <plugin-support.h>
 
+#include "cleanstream-filter.h"
+
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE(PLUGIN_NAME, "en-US")
 
@@ -32,11 +34,13 @@ extern struct obs_source_info cleanstream_filter_info;
 bool obs_module_load(void)
 {
 	obs_register_source(&cleanstream_filter_info);
+	cleanstream_module_load();
 	blog(LOG_INFO, "plugin loaded successfully (version %s)", PLUGIN_VERSION);
 	return true;
 }
 
 void obs_module_unload()
 {
+	cleanstream_module_unload();
 	blog(LOG_INFO, "plugin unloaded");
 }
@@ -0,0 +1,715 @@
+// Command line CleanStream for broadcast chains outside OBS, e.g.
+//   ffmpeg -i in -f s16le -ar 48000 -ac 2 - |
+//   cleanstream-cli --model ggml-tiny.en.bin --rate 48000 --channels 2 |
+//   ffmpeg -f s16le -ar 48000 -ac 2 -i - out
+// Reads raw interleaved PCM from stdin and writes the cleaned PCM to stdout, one analysis
+// segment behind. Files are read only as fast as they are analyzed. With --live the input is
+// real time (ffmpeg -re, a capture device): when the analysis falls behind the wall clock by
+// more than --max-latency-ms, segments are passed through unanalyzed until it has caught up,
+// so the latency stays bounded.
+
+#include "whisper-utils/detection.h"
+#include "whisper-utils/lexicon.h"
+#include "audio-utils/time-stretch.h"
+#include "audio-utils/vad.h"
+
+#include <whisper.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// same segmentation as the filter: 1010 ms windows overlapping by 340 ms
+#define WINDOW_MSEC 1010
+#define OVERLAP_MSEC 340
+#define VAD_THOLD 0.0001f
+#define FREQ_THOLD 100.0f
+#define CUT_FADE_MSEC 10
+// stdio buffers, large enough that reads and writes are a few syscalls per segment
+#define IO_BUFFER_BYTES (1 << 20)
+#define READ_BLOCK_BYTES (64 * 1024)
+
+namespace {
+
+enum class sample_format { s16le, f32le };
+enum class filler_action { silence, cut };
+
+struct cli_options {
+	std::string model;
+	uint32_t rate = 48000;
+	size_t channels = 2;
+	sample_format format = sample_format::s16le;
+	filler_action action = filler_action::silence;
+	int threads = 1;
+	// encoder context, -1 sizes it to the analysis input after time compression, 0 is
+	// whisper's full 30 s context
+	int audio_ctx = 0;
+	// time compression of the analysis input, 1 disables
+	double analysis_speed = 1.0;
+	// beams of a beam search, 0 decodes greedily
+	int beam_size = 0;
+	bool vad = true;
+	// the input arrives in real time, falling behind it skips analysis instead of reading slower
+	bool live = false;
+	uint32_t max_latency_ms = 3000;
+	std::string language = "en";
+	std::string detect_regex = "\\b(uh+)|(um+)|(ah+)\\b";
+	std::string beep_regex =
+		"(fuck)|(shit)|(bitch)|(cunt)|(pussy)|(dick)|(asshole)|(whore)|(cock)|(nigger)|(nigga)|(prick)";
+	std::string lexicon_path;
+	std::string edl_path;
+	std::string metrics_path;
+};
+
+// Interleaved float frames read from stdin, handed from the reader thread to the main loop.
+// The reader stops reading while the queue holds capacity samples.
+struct input_queue {
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::condition_variable space_cv;
+	std::vector<float> samples;
+	size_t capacity = 0;
+	// when the first samples were read, the start of the input on the wall clock
+	std::chrono::steady_clock::time_point first_read;
+	bool started = false;
+	bool eof = false;
+};
+
+// The cleaned audio written so far, except its last frames: after a cut they are faded out over
+// the head of the audio following the cut
+struct output_stream {
+	std::vector<float> held;
+	bool fade_pending = false;
+	std::vector<float> joined;
+};
+
+struct cli_metrics {
+	uint64_t segments = 0;
+	uint64_t analyzed = 0;
+	uint64_t vad_skipped = 0;
+	uint64_t backlog_skipped = 0;
+	uint64_t fillers = 0;
+	uint64_t beeps = 0;
+	uint64_t frames_in = 0;
+	uint64_t frames_out = 0;
+	double inference_sec = 0.0;
+	// inference time of the calls timed by stage, without --live, the part of it from the end
+	// of the encoder and the decoder passes in it
+	double timed_sec = 0.0;
+	double decode_sec = 0.0;
+	uint64_t decode_steps = 0;
+	// queued input, or with live input how far the analysis is behind the wall clock
+	double max_backlog_ms = 0.0;
+	std::vector<float> rtf;
+};
+
+void usage()
+{
+	fprintf(stderr,
+		"usage: cleanstream-cli --model <ggml model> [options] < in.pcm > out.pcm\n"
+		"  --rate <hz>              input and output sample rate (48000)\n"
+		"  --channels <n>           interleaved channels (2)\n"
+		"  --format <s16le|f32le>   sample format (s16le)\n"
+		"  --action <silence|cut>   what to do with fillers (silence)\n"
+		"  --threads <n>            whisper threads (1)\n"
+		"  --audio-ctx <n>          encoder context, 0 for the full context, -1 sized to the input (0)\n"
+		"  --analysis-speed <x>     time compress the analysis input, 1 to 2 (1)\n"
+		"  --beam-size <n>          beam search with n beams instead of greedy decoding\n"
+		"  --language <code>        spoken language (en)\n"
+		"  --detect <regex>         filler expression\n"
+		"  --beep <regex>           expression of words to beep\n"
+		"  --lexicon <file>         word list compiled with cleanstream-lexicon\n"
+		"  --no-vad                 analyze quiet segments too\n"
+		"  --live                   the input is real time, e.g. ffmpeg -re or a capture device\n"
+		"  --max-latency-ms <ms>    with --live, pass audio through unanalyzed this far behind (3000)\n"
+		"  --edl <file>             write the edits as tab separated values\n"
+		"  --metrics <file>         write performance metrics as JSON at the end\n");
+}
+
+bool parse_options(int argc, char **argv, cli_options &options)
+{
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		const bool has_value = i + 1 < argc;
+		const char *value = has_value ? argv[i + 1] : "";
+		if (arg == "--no-vad") {
+			options.vad = false;
+			continue;
+		}
+		if (arg == "--live") {
+			options.live = true;
+			continue;
+		}
+		if (!has_value) {
+			fprintf(stderr, "unknown or incomplete option %s\n", arg.c_str());
+			return false;
+		}
+		i++;
+		if (arg == "--model") {
+			options.model = value;
+		} else if (arg == "--rate") {
+			options.rate = (uint32_t)strtoul(value, nullptr, 10);
+		} else if (arg == "--channels") {
+			options.channels = (size_t)strtoul(value, nullptr, 10);
+		} else if (arg == "--format" && strcmp(value, "s16le") == 0) {
+			options.format = sample_format::s16le;
+		} else if (arg == "--format" && strcmp(value, "f32le") == 0) {
+			options.format = sample_format::f32le;
+		} else if (arg == "--action" && strcmp(value, "silence") == 0) {
+			options.action = filler_action::silence;
+		} else if (arg == "--action" && strcmp(value, "cut") == 0) {
+			options.action = filler_action::cut;
+		} else if (arg == "--threads") {
+			options.threads = std::max(1, atoi(value));
+		} else if (arg == "--audio-ctx") {
+			options.audio_ctx = std::max(-1, atoi(value));
+		} else if (arg == "--beam-size") {
+			options.beam_size = std::max(0, atoi(value));
+		} else if (arg == "--analysis-speed") {
+			options.analysis_speed = std::clamp(strtod(value, nullptr), 1.0, 2.0);
+		} else if (arg == "--language") {
+			options.language = value;
+		} else if (arg == "--detect") {
+			options.detect_regex = value;
+		} else if (arg == "--beep") {
+			options.beep_regex = value;
+		} else if (arg == "--lexicon") {
+			options.lexicon_path = value;
+		} else if (arg == "--max-latency-ms") {
+			options.max_latency_ms = (uint32_t)strtoul(value, nullptr, 10);
+		} else if (arg == "--edl") {
+			options.edl_path = value;
+		} else if (arg == "--metrics") {
+			options.metrics_path = value;
+		} else {
+			fprintf(stderr, "unknown option %s %s\n", arg.c_str(), value);
+			return false;
+		}
+	}
+	if (options.model.empty() || options.rate == 0 || options.channels == 0) {
+		return false;
+	}
+	return true;
+}
+
+// When the encoder of a whisper_full call started and the decoder passes after it, for the
+// decoder's share of the call. The decoders of a beam search advance together.
+struct decode_watch {
+	std::chrono::steady_clock::time_point encoder_begin;
+	bool encoder_begun = false;
+	std::atomic<int> steps{0};
+	std::atomic<int> step_tokens{-1};
+};
+
+bool decode_watch_encoder_begin(struct whisper_context *, struct whisper_state *, void *user_data)
+{
+	decode_watch *watch = static_cast<decode_watch *>(user_data);
+	watch->encoder_begin = std::chrono::steady_clock::now();
+	watch->encoder_begun = true;
+	return true;
+}
+
+void decode_watch_logits(struct whisper_context *, struct whisper_state *,
+			 const whisper_token_data *, int n_tokens, float *, void *user_data)
+{
+	decode_watch *watch = static_cast<decode_watch *>(user_data);
+	if (watch->step_tokens.exchange(n_tokens) != n_tokens) {
+		watch->steps++;
+	}
+}
+
+size_t bytes_per_sample(sample_format format)
+{
+	return format == sample_format::s16le ? 2 : 4;
+}
+
+void read_input(const cli_options &options, input_queue &queue)
+{
+	const size_t frame_bytes = bytes_per_sample(options.format) * options.channels;
+	std::vector<uint8_t> block(READ_BLOCK_BYTES - READ_BLOCK_BYTES % frame_bytes);
+	std::vector<float> samples;
+	size_t held = 0;
+	while (true) {
+		const size_t n = fread(block.data() + held, 1, block.size() - held, stdin);
+		held += n;
+		const size_t usable = held - held % frame_bytes;
+		samples.resize(usable / bytes_per_sample(options.format));
+		if (options.format == sample_format::s16le) {
+			for (size_t i = 0; i < samples.size(); i++) {
+				int16_t sample;
+				memcpy(&sample, block.data() + i * 2, 2);
+				samples[i] = (float)sample / 32768.0f;
+			}
+		} else {
+			memcpy(samples.data(), block.data(), usable);
+		}
+		memmove(block.data(), block.data() + usable, held - usable);
+		held -= usable;
+
+		std::unique_lock<std::mutex> lock(queue.mutex);
+		queue.space_cv.wait(lock, [&] { return queue.samples.size() < queue.capacity; });
+		if (!queue.started && !samples.empty()) {
+			queue.first_read = std::chrono::steady_clock::now();
+			queue.started = true;
+		}
+		queue.samples.insert(queue.samples.end(), samples.begin(), samples.end());
+		if (n == 0) {
+			queue.eof = true;
+		}
+		queue.cv.notify_one();
+		if (queue.eof) {
+			return;
+		}
+	}
+}
+
+// Downmix interleaved audio and resample it to 16 kHz mono for whisper, averaging the input
+// over each output period before interpolating
+void to_whisper_input(const float *interleaved, size_t frames, size_t channels, uint32_t rate,
+		      std::vector<float> &out)
+{
+	std::vector<float> mono(frames);
+	for (size_t i = 0; i < frames; i++) {
+		float sum = 0.0f;
+		for (size_t c = 0; c < channels; c++) {
+			sum += interleaved[i * channels + c];
+		}
+		mono[i] = sum / (float)channels;
+	}
+	const double step = (double)rate / WHISPER_SAMPLE_RATE;
+	const size_t box = std::max<size_t>(1, (size_t)step);
+	if (box > 1) {
+		// running mean as an anti-aliasing filter
+		std::vector<float> smoothed(frames);
+		double sum = 0.0;
+		for (size_t i = 0; i < frames; i++) {
+			sum += mono[i];
+			if (i >= box) {
+				sum -= mono[i - box];
+			}
+			smoothed[i] = (float)(sum / (double)std::min(i + 1, box));
+		}
+		mono.swap(smoothed);
+	}
+	out.resize((size_t)((double)frames / step));
+	for (size_t i = 0; i < out.size(); i++) {
+		const double pos = (double)i * step;
+		const size_t i0 = std::min((size_t)pos, frames - 1);
+		const size_t i1 = std::min(i0 + 1, frames - 1);
+		const float frac = (float)(pos - (double)i0);
+		out[i] = mono[i0] + (mono[i1] - mono[i0]) * frac;
+	}
+}
+
+void write_output(const cli_options &options, const float *interleaved, size_t samples,
+		  std::vector<uint8_t> &scratch)
+{
+	if (options.format == sample_format::s16le) {
+		scratch.resize(samples * 2);
+		for (size_t i = 0; i < samples; i++) {
+			const float clamped = std::clamp(interleaved[i], -1.0f, 1.0f);
+			const int16_t sample = (int16_t)lrintf(clamped * 32767.0f);
+			memcpy(scratch.data() + i * 2, &sample, 2);
+		}
+		fwrite(scratch.data(), 1, scratch.size(), stdout);
+	} else {
+		fwrite(interleaved, sizeof(float), samples, stdout);
+	}
+	// one write per segment keeps the output moving without a syscall per packet
+	fflush(stdout);
+}
+
+// Write a segment of interleaved audio, holding back its last fade frames. After a cut the held
+// back audio fades out over the head of the segment. Returns the frames added to the output.
+size_t output_segment(const cli_options &options, output_stream &stream, const float *segment,
+		      size_t frames, size_t fade_frames, std::vector<uint8_t> &scratch)
+{
+	const size_t channels = options.channels;
+	const size_t held_frames = stream.held.size() / channels;
+	size_t overlap = 0;
+	if (stream.fade_pending) {
+		if (stream.held.empty()) {
+			// nothing before the cut, fade in from silence
+			stream.held.assign(fade_frames * channels, 0.0f);
+		}
+		overlap = std::min(stream.held.size() / channels, frames);
+		for (size_t i = 0; i < overlap; i++) {
+			const float gain = (float)(i + 1) / (float)(overlap + 1);
+			for (size_t c = 0; c < channels; c++) {
+				float &sample = stream.held[i * channels + c];
+				sample = sample * (1.0f - gain) + segment[i * channels + c] * gain;
+			}
+		}
+		stream.fade_pending = false;
+	}
+	stream.joined.assign(stream.held.begin(), stream.held.end());
+	stream.joined.insert(stream.joined.end(), segment + overlap * channels,
+			     segment + frames * channels);
+	const size_t joined_frames = stream.joined.size() / channels;
+	const size_t write_frames = joined_frames - std::min(fade_frames, joined_frames);
+	write_output(options, stream.joined.data(), write_frames * channels, scratch);
+	stream.held.assign(stream.joined.begin() + (long)(write_frames * channels),
+			   stream.joined.end());
+	return joined_frames - held_frames;
+}
+
+float percentile(std::vector<float> values, double p)
+{
+	if (values.empty()) {
+		return 0.0f;
+	}
+	const size_t index = std::min(values.size() - 1, (size_t)(p * (double)values.size()));
+	std::nth_element(values.begin(), values.begin() + (long)index, values.end());
+	return values[index];
+}
+
+void write_metrics(const cli_options &options, const cli_metrics &metrics, double wall_sec)
+{
+	const double audio_sec = (double)metrics.frames_in / options.rate;
+	fprintf(stderr,
+		"cleanstream-cli: %.1f s of audio in %.1f s, %llu of %llu segments analyzed, real time factor p50 %.2f max %.2f, %llu passed through behind\n",
+		audio_sec, wall_sec, (unsigned long long)metrics.analyzed,
+		(unsigned long long)metrics.segments, percentile(metrics.rtf, 0.5),
+		percentile(metrics.rtf, 1.0), (unsigned long long)metrics.backlog_skipped);
+	if (options.metrics_path.empty()) {
+		return;
+	}
+	FILE *file = fopen(options.metrics_path.c_str(), "w");
+	if (file == nullptr) {
+		fprintf(stderr, "cannot write %s\n", options.metrics_path.c_str());
+		return;
+	}
+	fprintf(file,
+		"{\n"
+		"  \"audio_sec\": %.3f,\n"
+		"  \"wall_sec\": %.3f,\n"
+		"  \"output_sec\": %.3f,\n"
+		"  \"inference_sec\": %.3f,\n"
+		"  \"decoder_share\": %.3f,\n"
+		"  \"decoder_pass_ms\": %.2f,\n"
+		"  \"segments\": %llu,\n"
+		"  \"analyzed\": %llu,\n"
+		"  \"vad_skipped\": %llu,\n"
+		"  \"backlog_skipped\": %llu,\n"
+		"  \"fillers\": %llu,\n"
+		"  \"beeps\": %llu,\n"
+		"  \"rtf_p50\": %.3f,\n"
+		"  \"rtf_p90\": %.3f,\n"
+		"  \"rtf_p99\": %.3f,\n"
+		"  \"rtf_max\": %.3f,\n"
+		"  \"max_backlog_ms\": %.0f,\n"
+		"  \"analysis_speed\": %.2f,\n"
+		"  \"beam_size\": %d\n"
+		"}\n",
+		audio_sec, wall_sec, (double)metrics.frames_out / options.rate,
+		metrics.inference_sec,
+		metrics.timed_sec > 0.0 ? metrics.decode_sec / metrics.timed_sec : 0.0,
+		metrics.decode_steps > 0 ? metrics.decode_sec * 1000.0 / (double)metrics.decode_steps
+					 : 0.0,
+		(unsigned long long)metrics.segments,
+		(unsigned long long)metrics.analyzed, (unsigned long long)metrics.vad_skipped,
+		(unsigned long long)metrics.backlog_skipped, (unsigned long long)metrics.fillers,
+		(unsigned long long)metrics.beeps, percentile(metrics.rtf, 0.5),
+		percentile(metrics.rtf, 0.9), percentile(metrics.rtf, 0.99),
+		percentile(metrics.rtf, 1.0), metrics.max_backlog_ms, options.analysis_speed,
+		options.beam_size);
+	fclose(file);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	cli_options options;
+	if (!parse_options(argc, argv, options)) {
+		usage();
+		return 2;
+	}
+	if (options.channels > 8) {
+		fprintf(stderr, "at most 8 channels are supported\n");
+		return 2;
+	}
+
+	// an empty expression disables the rule, as in the filter
+	std::regex filler_regex;
+	std::regex beep_regex;
+	try {
+		if (!options.detect_regex.empty()) {
+			filler_regex.assign(options.detect_regex);
+		}
+		if (!options.beep_regex.empty()) {
+			beep_regex.assign(options.beep_regex);
+		}
+	} catch (const std::regex_error &e) {
+		fprintf(stderr, "regex error: %s\n", e.what());
+		return 2;
+	}
+	std::shared_ptr<const lexicon> lexicon;
+	if (!options.lexicon_path.empty()) {
+		std::string lexicon_error;
+		lexicon = lexicon_load(options.lexicon_path, lexicon_error);
+		if (lexicon == nullptr) {
+			fprintf(stderr, "cannot load lexicon %s: %s\n", options.lexicon_path.c_str(),
+				lexicon_error.c_str());
+			return 2;
+		}
+	}
+
+	struct whisper_context *ctx = whisper_init_from_file_with_params(
+		options.model.c_str(), whisper_context_default_params());
+	if (ctx == nullptr) {
+		fprintf(stderr, "failed to load model %s\n", options.model.c_str());
+		return 1;
+	}
+
+	// the filter's parameters, with greedy decoding to stay real time on one core
+	whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+	params.language = options.language.c_str();
+	params.initial_prompt = "uhm, Uh, um, Uhh, um. um... uh. uh... ";
+	params.n_threads = options.threads;
+	params.no_context = true;
+	params.single_segment = true;
+	params.print_special = false;
+	params.print_progress = false;
+	params.print_realtime = false;
+	params.print_timestamps = false;
+	params.max_tokens = 3;
+	params.suppress_non_speech_tokens = true;
+	params.temperature = 0.5f;
+	params.max_initial_ts = 1.0f;
+	params.length_penalty = -1.0f;
+	if (options.beam_size > 0) {
+		params.strategy = WHISPER_SAMPLING_BEAM_SEARCH;
+		params.beam_search.beam_size = options.beam_size;
+	}
+	decode_watch watch;
+	params.encoder_begin_callback = decode_watch_encoder_begin;
+	params.encoder_begin_callback_user_data = &watch;
+	params.logits_filter_callback = decode_watch_logits;
+	params.logits_filter_callback_user_data = &watch;
+	// whisper's context positions are 20 ms each
+	params.audio_ctx = options.audio_ctx >= 0
+				   ? options.audio_ctx
+				   : (int)std::ceil(WINDOW_MSEC / options.analysis_speed / 20.0);
+
+	FILE *edl = nullptr;
+	if (!options.edl_path.empty()) {
+		edl = fopen(options.edl_path.c_str(), "w");
+		if (edl == nullptr) {
+			fprintf(stderr, "cannot write %s\n", options.edl_path.c_str());
+			whisper_free(ctx);
+			return 1;
+		}
+		fprintf(edl, "start\tend\toutput_start\taction\ttext\n");
+	}
+
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	setvbuf(stdin, nullptr, _IOFBF, IO_BUFFER_BYTES);
+	setvbuf(stdout, nullptr, _IOFBF, IO_BUFFER_BYTES);
+
+	const size_t channels = options.channels;
+	const size_t window_frames = (size_t)options.rate * WINDOW_MSEC / 1000;
+	const size_t overlap_frames = (size_t)options.rate * OVERLAP_MSEC / 1000;
+	const size_t segment_frames = window_frames - overlap_frames;
+	const size_t max_backlog_frames = (size_t)options.rate * options.max_latency_ms / 1000;
+	const size_t fade_frames = (size_t)options.rate * CUT_FADE_MSEC / 1000;
+
+	// live input falls behind by the latency bound before the queue is full
+	input_queue queue;
+	queue.capacity = (max_backlog_frames + 2 * segment_frames) * channels;
+	std::thread reader(read_input, std::cref(options), std::ref(queue));
+
+	// the analysis window, the overlap from the previous segment followed by the new frames
+	std::vector<float> window(window_frames * channels, 0.0f);
+	std::vector<float> segment;
+	std::vector<float> pcm16k;
+	std::vector<float> compressed[1];
+	std::vector<float> vad_input;
+	std::vector<uint8_t> scratch;
+	output_stream stream;
+	cli_metrics metrics;
+	const auto start = std::chrono::steady_clock::now();
+	bool eof = false;
+
+	while (!eof) {
+		size_t backlog_frames = 0;
+		std::chrono::steady_clock::time_point first_read;
+		{
+			std::unique_lock<std::mutex> lock(queue.mutex);
+			queue.cv.wait(lock, [&] {
+				return queue.eof || queue.samples.size() >= segment_frames * channels;
+			});
+			const size_t take = std::min(queue.samples.size(), segment_frames * channels);
+			segment.assign(queue.samples.begin(), queue.samples.begin() + (long)take);
+			queue.samples.erase(queue.samples.begin(), queue.samples.begin() + (long)take);
+			backlog_frames = queue.samples.size() / channels;
+			first_read = queue.first_read;
+			eof = queue.eof && queue.samples.empty();
+		}
+		queue.space_cv.notify_one();
+		const size_t frames = segment.size() / channels;
+		if (frames == 0) {
+			break;
+		}
+		const uint64_t segment_start = metrics.frames_in;
+		metrics.frames_in += frames;
+		metrics.segments++;
+		if (options.live) {
+			// the segment's end arrived this long ago, on the wall clock
+			const double elapsed_ms = std::chrono::duration<double, std::milli>(
+							  std::chrono::steady_clock::now() - first_read)
+							  .count();
+			backlog_frames = (size_t)std::max(
+				0.0, (elapsed_ms - (double)metrics.frames_in * 1000.0 / options.rate) *
+					     options.rate / 1000.0);
+		}
+		metrics.max_backlog_ms =
+			std::max(metrics.max_backlog_ms, (double)backlog_frames * 1000.0 / options.rate);
+
+		// slide the window: keep the overlap, append the new frames
+		const size_t keep = window_frames - frames;
+		memmove(window.data(), window.data() + frames * channels, keep * channels * sizeof(float));
+		memcpy(window.data() + keep * channels, segment.data(), frames * channels * sizeof(float));
+
+		int result = DETECTION_RESULT_UNKNOWN;
+		std::string text;
+		if (options.live && backlog_frames > max_backlog_frames) {
+			// too far behind, pass through until the analysis has caught up
+			metrics.backlog_skipped++;
+		} else {
+			to_whisper_input(window.data(), window_frames, channels, options.rate, pcm16k);
+			// the VAD filters its input in place
+			vad_input = pcm16k;
+			if (options.vad &&
+			    !vad_simple(vad_input.data(), vad_input.size(), WHISPER_SAMPLE_RATE,
+					VAD_THOLD, FREQ_THOLD)) {
+				metrics.vad_skipped++;
+				result = DETECTION_RESULT_SILENCE;
+			} else {
+				const auto inference_start = std::chrono::steady_clock::now();
+				watch.encoder_begun = false;
+				watch.steps = 0;
+				watch.step_tokens = -1;
+				const float *input = pcm16k.data();
+				size_t input_size = pcm16k.size();
+				if (options.analysis_speed > 1.0) {
+					input_size = time_compress(&input, 1, input_size,
+								   options.analysis_speed,
+								   WHISPER_SAMPLE_RATE, compressed);
+					input = compressed[0].data();
+				}
+				if (whisper_full(ctx, params, input, (int)input_size) == 0) {
+					text = whisper_full_n_segments(ctx) > 0
+						       ? normalize_text(
+							       whisper_full_get_segment_text(ctx, 0))
+						       : "";
+					result = classify_text(
+						text,
+						options.detect_regex.empty() ? nullptr
+									     : &filler_regex,
+						options.beep_regex.empty() ? nullptr : &beep_regex);
+					if (result == DETECTION_RESULT_SPEECH && lexicon) {
+						result = lexicon_match(*lexicon, text);
+					}
+				}
+				const auto inference_end = std::chrono::steady_clock::now();
+				const double inference_sec =
+					std::chrono::duration<double>(inference_end - inference_start)
+						.count();
+				if (watch.encoder_begun && !options.live) {
+					// whisper calls nothing when the encoder ends: encode the
+					// same mel once more to time it, not counted in inference_sec
+					// but slowing down a live stream
+					whisper_encode(ctx, 0, params.n_threads);
+					const auto encoder_end = std::chrono::steady_clock::now();
+					const double encoder_sec =
+						std::chrono::duration<double>(encoder_end - inference_end)
+							.count();
+					const double decode_sec =
+						std::chrono::duration<double>(inference_end -
+									      watch.encoder_begin)
+							.count() -
+						encoder_sec;
+					if (decode_sec > 0.0) {
+						metrics.timed_sec += inference_sec;
+						metrics.decode_sec += decode_sec;
+						metrics.decode_steps += (uint64_t)watch.steps;
+					}
+				}
+				metrics.analyzed++;
+				metrics.inference_sec += inference_sec;
+				metrics.rtf.push_back(
+					(float)(inference_sec / ((double)segment_frames / options.rate)));
+			}
+		}
+
+		bool cut = false;
+		const char *action = nullptr;
+		if (result == DETECTION_RESULT_FILLER) {
+			metrics.fillers++;
+			if (options.action == filler_action::cut) {
+				cut = true;
+				action = "cut";
+			} else {
+				std::fill(segment.begin(), segment.end(), 0.0f);
+				action = "silence";
+			}
+		} else if (result == DETECTION_RESULT_BEEP) {
+			metrics.beeps++;
+			for (size_t i = 0; i < frames; i++) {
+				// add a beep at A4 (440Hz)
+				const float beep = 0.5f * sinf(2.0f * 3.14159265f * 440.0f *
+							       (float)i / (float)options.rate);
+				for (size_t c = 0; c < channels; c++) {
+					segment[i * channels + c] = beep;
+				}
+			}
+			action = "beep";
+		}
+		if (edl != nullptr && action != nullptr) {
+			fprintf(edl, "%.3f\t%.3f\t%.3f\t%s\t%s\n",
+				(double)segment_start / options.rate,
+				(double)(segment_start + frames) / options.rate,
+				(double)metrics.frames_out / options.rate, action, text.c_str());
+			fflush(edl);
+		}
+
+		if (cut) {
+			// the audio before the cut fades out over the audio after it
+			stream.fade_pending = true;
+		} else {
+			metrics.frames_out += output_segment(options, stream, segment.data(), frames,
+							     fade_frames, scratch);
+		}
+	}
+	write_output(options, stream.held.data(), stream.held.size(), scratch);
+
+	reader.join();
+	const double wall_sec =
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	write_metrics(options, metrics, wall_sec);
+	if (edl != nullptr) {
+		fclose(edl);
+	}
+	whisper_free(ctx);
+	return 0;
+}
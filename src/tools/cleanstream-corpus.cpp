@@ -0,0 +1,658 @@
+// Build a benchmark corpus from clean clips, e.g.
+//   cleanstream-corpus --clips clips --out corpus --snr 30,10,5 --speed 1,1.15 --fillers 2,8
+// The clips directory holds WAV files in speech/ and fillers/, and optionally noise/. Without
+// --clips a built-in set of synthetic clips is used, which needs no downloads.
+// Every combination of SNR, speaking rate and filler rate gets --count files of speech
+// with fillers between the utterances and noise mixed in at the SNR, written as
+//   <name>.wav    16 bit mono at --rate
+//   <name>.tsv    start, end, label (speech or filler) and clip of every placed clip
+// and corpus.tsv lists the files with their parameters.
+// The output only depends on the clips, the arguments and the seed: the random numbers are
+// drawn here rather than with the standard library distributions, which differ between
+// implementations.
+
+#include "audio-utils/time-stretch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// silence around the utterances and between them
+#define LEAD_SEC 0.5
+#define MIN_GAP_SEC 0.15
+#define MAX_GAP_SEC 0.6
+// M_PI is not defined by MSVC without _USE_MATH_DEFINES
+#define PI 3.14159265358979323846
+// the built-in clips, always made from the same seed
+#define SYNTH_SEED 0x636c6970ULL
+#define SYNTH_SPEECH_CLIPS 16
+#define SYNTH_FILLER_CLIPS 6
+
+namespace {
+
+struct corpus_options {
+	std::string clips_dir;
+	std::string out_dir;
+	uint32_t rate = 48000;
+	double duration_sec = 60.0;
+	int count = 1;
+	uint64_t seed = 1;
+	// "inf" for no noise
+	std::vector<double> snr_db = {20.0};
+	std::vector<double> speeds = {1.0};
+	std::vector<double> fillers_per_min = {4.0};
+};
+
+struct clip {
+	std::string name;
+	std::vector<float> samples;
+};
+
+// Generated noise when noise/ has no clips
+enum class noise_color { white, pink, brown };
+
+// Reproducible random numbers, uniform in [0, 1)
+class corpus_random {
+public:
+	explicit corpus_random(uint64_t seed) : engine(seed) {}
+	double uniform() { return (double)(engine() >> 11) * (1.0 / 9007199254740992.0); }
+	double uniform(double low, double high) { return low + (high - low) * uniform(); }
+	size_t index(size_t n) { return std::min((size_t)(uniform() * (double)n), n - 1); }
+	double exponential(double mean) { return -std::log(1.0 - uniform()) * mean; }
+	// standard normal, Box-Muller
+	double normal()
+	{
+		const double u1 = 1.0 - uniform();
+		const double u2 = uniform();
+		return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * PI * u2);
+	}
+
+private:
+	std::mt19937_64 engine;
+};
+
+void usage()
+{
+	fprintf(stderr,
+		"usage: cleanstream-corpus --out <dir> [options]\n"
+		"  --clips <dir>            clips in speech/, fillers/ and noise/ (synthetic clips)\n"
+		"  --rate <hz>              output sample rate (48000)\n"
+		"  --duration <sec>         length of every file (60)\n"
+		"  --count <n>              files per combination (1)\n"
+		"  --seed <n>               random seed (1)\n"
+		"  --snr <db,...>           speech to noise ratios, inf for no noise (20)\n"
+		"  --speed <x,...>          speaking rates, 1 or faster (1)\n"
+		"  --fillers <n,...>        fillers per minute of speech (4)\n");
+}
+
+std::vector<double> parse_list(const char *value)
+{
+	std::vector<double> values;
+	const char *p = value;
+	while (*p != '\0') {
+		char *end = nullptr;
+		const double v = strncmp(p, "inf", 3) == 0 ? INFINITY : strtod(p, &end);
+		end = strncmp(p, "inf", 3) == 0 ? (char *)p + 3 : end;
+		if (end == p) {
+			return {};
+		}
+		values.push_back(v);
+		p = *end == ',' ? end + 1 : end;
+	}
+	return values;
+}
+
+bool parse_options(int argc, char **argv, corpus_options &options)
+{
+	for (int i = 1; i + 1 < argc; i += 2) {
+		const std::string arg = argv[i];
+		const char *value = argv[i + 1];
+		if (arg == "--clips") {
+			options.clips_dir = value;
+		} else if (arg == "--out") {
+			options.out_dir = value;
+		} else if (arg == "--rate") {
+			options.rate = (uint32_t)strtoul(value, nullptr, 10);
+		} else if (arg == "--duration") {
+			options.duration_sec = strtod(value, nullptr);
+		} else if (arg == "--count") {
+			options.count = std::max(1, atoi(value));
+		} else if (arg == "--seed") {
+			options.seed = strtoull(value, nullptr, 10);
+		} else if (arg == "--snr") {
+			options.snr_db = parse_list(value);
+		} else if (arg == "--speed") {
+			options.speeds = parse_list(value);
+		} else if (arg == "--fillers") {
+			options.fillers_per_min = parse_list(value);
+		} else {
+			fprintf(stderr, "unknown option %s\n", arg.c_str());
+			return false;
+		}
+	}
+	if (argc % 2 == 0) {
+		fprintf(stderr, "missing value of %s\n", argv[argc - 1]);
+		return false;
+	}
+	for (double speed : options.speeds) {
+		if (speed < 1.0) {
+			fprintf(stderr, "speaking rates below 1 are not supported\n");
+			return false;
+		}
+	}
+	return !options.out_dir.empty() && options.rate > 0 &&
+	       options.duration_sec > 2 * LEAD_SEC && !options.snr_db.empty() &&
+	       !options.speeds.empty() && !options.fillers_per_min.empty();
+}
+
+uint32_t read_u32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+uint16_t read_u16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | p[1] << 8);
+}
+
+// Read a 16 bit or float WAV file as mono at the given rate, false if it is not one
+bool read_wav(const fs::path &path, uint32_t rate, std::vector<float> &out)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+				  std::istreambuf_iterator<char>());
+	if (data.size() < 12 || memcmp(data.data(), "RIFF", 4) != 0 ||
+	    memcmp(data.data() + 8, "WAVE", 4) != 0) {
+		return false;
+	}
+	uint16_t format = 0, channels = 0, bits = 0;
+	uint32_t file_rate = 0;
+	const uint8_t *pcm = nullptr;
+	size_t pcm_size = 0;
+	for (size_t pos = 12; pos + 8 <= data.size();) {
+		const uint32_t chunk_size = read_u32(data.data() + pos + 4);
+		const uint8_t *chunk = data.data() + pos + 8;
+		const size_t available = std::min((size_t)chunk_size, data.size() - pos - 8);
+		if (memcmp(data.data() + pos, "fmt ", 4) == 0 && available >= 16) {
+			format = read_u16(chunk);
+			channels = read_u16(chunk + 2);
+			file_rate = read_u32(chunk + 4);
+			bits = read_u16(chunk + 14);
+		} else if (memcmp(data.data() + pos, "data", 4) == 0) {
+			pcm = chunk;
+			pcm_size = available;
+		}
+		pos += 8 + (size_t)chunk_size + (chunk_size & 1);
+	}
+	const bool is_s16 = format == 1 && bits == 16;
+	const bool is_f32 = format == 3 && bits == 32;
+	if (pcm == nullptr || channels == 0 || file_rate == 0 || (!is_s16 && !is_f32)) {
+		return false;
+	}
+
+	const size_t frame_bytes = (size_t)channels * bits / 8;
+	const size_t frames = pcm_size / frame_bytes;
+	std::vector<float> mono(frames);
+	for (size_t i = 0; i < frames; i++) {
+		float sum = 0.0f;
+		for (size_t c = 0; c < channels; c++) {
+			const uint8_t *sample = pcm + i * frame_bytes + c * bits / 8;
+			if (is_s16) {
+				sum += (float)(int16_t)read_u16(sample) / 32768.0f;
+			} else {
+				float value;
+				memcpy(&value, sample, 4);
+				sum += value;
+			}
+		}
+		mono[i] = sum / (float)channels;
+	}
+
+	// linear interpolation, the clips are expected at about the output rate
+	const size_t out_frames = (size_t)((double)frames * rate / file_rate);
+	out.resize(out_frames);
+	for (size_t i = 0; i < out_frames; i++) {
+		const double pos = (double)i * file_rate / rate;
+		const size_t i0 = std::min((size_t)pos, frames - 1);
+		const size_t i1 = std::min(i0 + 1, frames - 1);
+		const float frac = (float)(pos - (double)i0);
+		out[i] = mono[i0] * (1.0f - frac) + mono[i1] * frac;
+	}
+	return true;
+}
+
+bool write_wav(const fs::path &path, const std::vector<float> &samples, uint32_t rate)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	auto u32 = [&file](uint32_t v) {
+		const uint8_t b[4] = {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16),
+				      (uint8_t)(v >> 24)};
+		file.write((const char *)b, 4);
+	};
+	auto u16 = [&file](uint16_t v) {
+		const uint8_t b[2] = {(uint8_t)v, (uint8_t)(v >> 8)};
+		file.write((const char *)b, 2);
+	};
+	const uint32_t data_size = (uint32_t)(samples.size() * 2);
+	file.write("RIFF", 4);
+	u32(36 + data_size);
+	file.write("WAVEfmt ", 8);
+	u32(16);
+	u16(1);
+	u16(1);
+	u32(rate);
+	u32(rate * 2);
+	u16(2);
+	u16(16);
+	file.write("data", 4);
+	u32(data_size);
+	for (float sample : samples) {
+		const float clamped = std::clamp(sample, -1.0f, 1.0f);
+		u16((uint16_t)(int16_t)std::lround(clamped * 32767.0f));
+	}
+	return (bool)file;
+}
+
+// The WAV files of a directory in name order, so the corpus does not depend on the listing
+std::vector<clip> load_clips(const fs::path &dir, uint32_t rate)
+{
+	std::vector<fs::path> paths;
+	std::error_code ec;
+	for (auto it = fs::directory_iterator(dir, ec); !ec && it != fs::directory_iterator();
+	     it.increment(ec)) {
+		if (it->path().extension() == ".wav") {
+			paths.push_back(it->path());
+		}
+	}
+	std::sort(paths.begin(), paths.end());
+	std::vector<clip> clips;
+	for (const fs::path &path : paths) {
+		clip loaded;
+		loaded.name = path.filename().u8string();
+		if (read_wav(path, rate, loaded.samples) && !loaded.samples.empty()) {
+			clips.push_back(std::move(loaded));
+		} else {
+			fprintf(stderr, "skipping %s, not a 16 bit or float WAV file\n",
+				path.u8string().c_str());
+		}
+	}
+	return clips;
+}
+
+// Formants of a vowel in Hz
+struct formants {
+	double f1;
+	double f2;
+	double f3;
+};
+
+// a, e, i, o, u
+const formants vowels[] = {
+	{730.0, 1090.0, 2440.0}, {530.0, 1840.0, 2480.0}, {270.0, 2290.0, 3010.0},
+	{570.0, 840.0, 2410.0},  {300.0, 870.0, 2240.0},
+};
+const formants schwa = {500.0, 1500.0, 2500.0};
+const formants nasal = {250.0, 1200.0, 2200.0};
+
+// Two pole resonator with unity gain at 0 Hz, as in Klatt's synthesizer
+class resonator {
+public:
+	resonator(double freq, double bandwidth, uint32_t rate)
+	{
+		const double r = std::exp(-PI * bandwidth / rate);
+		b = 2.0 * r * std::cos(2.0 * PI * freq / rate);
+		c = -r * r;
+		a = 1.0 - b - c;
+	}
+	double process(double x)
+	{
+		const double y = a * x + b * y1 + c * y2;
+		y2 = y1;
+		y1 = y;
+		return y;
+	}
+
+private:
+	double a, b, c;
+	double y1 = 0.0, y2 = 0.0;
+};
+
+// Append a sound: a glottal pulse train gliding from f0_start to f0_end through the formants,
+// or noise through a single high resonance for a fricative when f0_start is 0
+void synth_sound(std::vector<float> &out, corpus_random &random, uint32_t rate,
+		 const formants &shape, double sec, double f0_start, double f0_end, double gain)
+{
+	const size_t frames = (size_t)(sec * rate);
+	const size_t edge = std::min(frames / 2, (size_t)(0.015 * rate));
+	resonator r1(shape.f1, 90.0, rate);
+	resonator r2(shape.f2, 110.0, rate);
+	resonator r3(shape.f3, 170.0, rate);
+	double phase = 0.0;
+	for (size_t i = 0; i < frames; i++) {
+		double sample;
+		if (f0_start > 0.0) {
+			const double f0 = f0_start + (f0_end - f0_start) * (double)i / (double)frames;
+			phase += f0 / rate;
+			double source = 0.02 * random.normal();
+			if (phase >= 1.0) {
+				phase -= 1.0;
+				source += 1.0;
+			}
+			sample = r3.process(r2.process(r1.process(source)));
+		} else {
+			sample = r1.process(random.normal()) * 0.3;
+		}
+		// raised cosine edges
+		double envelope = 1.0;
+		if (i < edge) {
+			envelope = 0.5 - 0.5 * std::cos(PI * (double)i / (double)edge);
+		} else if (i >= frames - edge) {
+			envelope = 0.5 - 0.5 * std::cos(PI * (double)(frames - i) / (double)edge);
+		}
+		out.push_back((float)(sample * envelope * gain));
+	}
+}
+
+void normalize_peak(std::vector<float> &samples, float target)
+{
+	float peak = 0.0f;
+	for (float sample : samples) {
+		peak = std::max(peak, std::fabs(sample));
+	}
+	if (peak > 0.0f) {
+		for (float &sample : samples) {
+			sample *= target / peak;
+		}
+	}
+}
+
+// Speech-like syllables of vowels and fricatives with a falling pitch, and "uh" and "um"
+// fillers: they exercise the timing, the VAD and the inference time without any download,
+// detection accuracy needs recorded clips
+void synth_clips(uint32_t rate, std::vector<clip> &speech, std::vector<clip> &fillers)
+{
+	corpus_random random(SYNTH_SEED);
+	for (int i = 0; i < SYNTH_SPEECH_CLIPS; i++) {
+		clip made;
+		made.name = "synthetic-speech-" + std::to_string(i + 1);
+		const double f0 = random.uniform(100.0, 220.0);
+		const int syllables = 4 + (int)random.index(9);
+		for (int s = 0; s < syllables; s++) {
+			// declination over the utterance
+			const double f0_start = f0 * (1.0 - 0.2 * s / syllables);
+			const double f0_end = f0 * (1.0 - 0.2 * (s + 1) / syllables);
+			if (random.uniform() < 0.7) {
+				const formants fricative = {random.uniform(3000.0, 5000.0), 0.0, 0.0};
+				synth_sound(made.samples, random, rate, fricative,
+					    random.uniform(0.04, 0.09), 0.0, 0.0, 1.0);
+			}
+			synth_sound(made.samples, random, rate, vowels[random.index(5)],
+				    random.uniform(0.08, 0.25), f0_start, f0_end, 1.0);
+		}
+		normalize_peak(made.samples, 0.5f);
+		speech.push_back(std::move(made));
+	}
+	for (int i = 0; i < SYNTH_FILLER_CLIPS; i++) {
+		clip made;
+		const bool um = i % 2 == 1;
+		made.name = std::string(um ? "synthetic-um-" : "synthetic-uh-") +
+			    std::to_string(i / 2 + 1);
+		const double f0 = random.uniform(100.0, 200.0);
+		if (um) {
+			synth_sound(made.samples, random, rate, schwa, random.uniform(0.2, 0.35),
+				    f0, f0 * 0.95, 1.0);
+			synth_sound(made.samples, random, rate, nasal, random.uniform(0.2, 0.35),
+				    f0 * 0.95, f0 * 0.9, 0.5);
+		} else {
+			synth_sound(made.samples, random, rate, schwa, random.uniform(0.3, 0.6), f0,
+				    f0 * 0.9, 1.0);
+		}
+		normalize_peak(made.samples, 0.5f);
+		fillers.push_back(std::move(made));
+	}
+}
+
+std::vector<float> speed_up(const std::vector<float> &samples, double speed, uint32_t rate)
+{
+	if (speed <= 1.0) {
+		return samples;
+	}
+	const float *in[1] = {samples.data()};
+	std::vector<float> out[1];
+	const size_t frames = time_compress(in, 1, samples.size(), speed, rate, out);
+	out[0].resize(frames);
+	return out[0];
+}
+
+std::vector<float> make_noise(corpus_random &random, const std::vector<clip> &noise_clips,
+			      size_t frames)
+{
+	std::vector<float> noise(frames);
+	if (!noise_clips.empty()) {
+		// loop a clip from a random offset
+		const clip &source = noise_clips[random.index(noise_clips.size())];
+		size_t pos = random.index(source.samples.size());
+		for (size_t i = 0; i < frames; i++) {
+			noise[i] = source.samples[pos];
+			pos = (pos + 1) % source.samples.size();
+		}
+		return noise;
+	}
+	const noise_color color = (noise_color)random.index(3);
+	// pink noise by Paul Kellet's economy filter, brown noise by a leaky integrator
+	double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+	for (size_t i = 0; i < frames; i++) {
+		const double white = random.normal();
+		if (color == noise_color::white) {
+			noise[i] = (float)white;
+		} else if (color == noise_color::pink) {
+			b0 = 0.99765 * b0 + white * 0.0990460;
+			b1 = 0.96300 * b1 + white * 0.2965164;
+			b2 = 0.57000 * b2 + white * 1.0526913;
+			noise[i] = (float)(b0 + b1 + b2 + white * 0.1848);
+		} else {
+			b0 = 0.998 * b0 + white * 0.05;
+			noise[i] = (float)b0;
+		}
+	}
+	return noise;
+}
+
+double rms(const std::vector<float> &samples, const std::vector<bool> *mask = nullptr)
+{
+	double sum = 0.0;
+	size_t n = 0;
+	for (size_t i = 0; i < samples.size(); i++) {
+		if (mask == nullptr || (*mask)[i]) {
+			sum += (double)samples[i] * samples[i];
+			n++;
+		}
+	}
+	return n > 0 ? std::sqrt(sum / (double)n) : 0.0;
+}
+
+struct placed_clip {
+	size_t start;
+	size_t end;
+	const char *label;
+	std::string name;
+};
+
+// One corpus file: utterances with fillers between them at about fillers_per_min, then the
+// noise at the SNR of the speech
+void build_item(const corpus_options &options, corpus_random &random,
+		const std::vector<clip> &speech, const std::vector<clip> &fillers,
+		const std::vector<clip> &noise_clips, double snr_db, double speed,
+		double fillers_per_min, std::vector<float> &mix, std::vector<placed_clip> &placed)
+{
+	const size_t frames = (size_t)(options.duration_sec * options.rate);
+	const size_t lead = (size_t)(LEAD_SEC * options.rate);
+	mix.assign(frames, 0.0f);
+	std::vector<bool> voiced(frames, false);
+	placed.clear();
+
+	const double filler_interval_sec = fillers_per_min > 0 ? 60.0 / fillers_per_min : 0.0;
+	double next_filler_sec =
+		filler_interval_sec > 0 ? random.exponential(filler_interval_sec) : INFINITY;
+	size_t pos = lead;
+	while (true) {
+		const bool is_filler = !fillers.empty() &&
+				       (double)pos / options.rate >= next_filler_sec;
+		const std::vector<clip> &source = is_filler ? fillers : speech;
+		const clip &chosen = source[random.index(source.size())];
+		const std::vector<float> samples = speed_up(chosen.samples, speed, options.rate);
+		if (pos + samples.size() + lead > frames) {
+			break;
+		}
+		std::copy(samples.begin(), samples.end(), mix.begin() + (ptrdiff_t)pos);
+		std::fill(voiced.begin() + (ptrdiff_t)pos,
+			  voiced.begin() + (ptrdiff_t)(pos + samples.size()), true);
+		placed.push_back({pos, pos + samples.size(), is_filler ? "filler" : "speech",
+				  chosen.name});
+		pos += samples.size() +
+		       (size_t)(random.uniform(MIN_GAP_SEC, MAX_GAP_SEC) / speed * options.rate);
+		if (is_filler) {
+			next_filler_sec = (double)pos / options.rate +
+					  random.exponential(filler_interval_sec);
+		}
+	}
+
+	if (std::isfinite(snr_db)) {
+		std::vector<float> noise = make_noise(random, noise_clips, frames);
+		const double noise_rms = rms(noise);
+		const double gain = noise_rms > 0.0 ? rms(mix, &voiced) /
+							      std::pow(10.0, snr_db / 20.0) /
+							      noise_rms
+						    : 0.0;
+		for (size_t i = 0; i < frames; i++) {
+			mix[i] += (float)(noise[i] * gain);
+		}
+	}
+
+	// keep the mix from clipping, the SNR is unchanged
+	float peak = 0.0f;
+	for (float sample : mix) {
+		peak = std::max(peak, std::fabs(sample));
+	}
+	if (peak > 0.99f) {
+		for (float &sample : mix) {
+			sample *= 0.99f / peak;
+		}
+	}
+}
+
+std::string format_value(double value)
+{
+	if (!std::isfinite(value)) {
+		return "inf";
+	}
+	char text[32];
+	snprintf(text, sizeof(text), "%g", value);
+	return text;
+}
+
+// FNV-1a of the name, starting from the seed
+uint64_t name_seed(uint64_t seed, const std::string &name)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL ^ seed;
+	for (unsigned char c : name) {
+		hash = (hash ^ c) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	corpus_options options;
+	if (!parse_options(argc, argv, options)) {
+		usage();
+		return 2;
+	}
+
+	const fs::path clips_dir = fs::u8path(options.clips_dir);
+	std::vector<clip> speech;
+	std::vector<clip> fillers;
+	std::vector<clip> noise;
+	if (options.clips_dir.empty()) {
+		synth_clips(options.rate, speech, fillers);
+	} else {
+		speech = load_clips(clips_dir / "speech", options.rate);
+		fillers = load_clips(clips_dir / "fillers", options.rate);
+		noise = load_clips(clips_dir / "noise", options.rate);
+	}
+	if (speech.empty()) {
+		fprintf(stderr, "no WAV files in %s\n", (clips_dir / "speech").u8string().c_str());
+		return 1;
+	}
+	if (fillers.empty()) {
+		fprintf(stderr, "no WAV files in %s, the corpus has no fillers\n",
+			(clips_dir / "fillers").u8string().c_str());
+	}
+
+	const fs::path out_dir = fs::u8path(options.out_dir);
+	std::error_code ec;
+	fs::create_directories(out_dir, ec);
+	std::ofstream manifest(out_dir / "corpus.tsv", std::ios::trunc);
+	manifest << "name\tsnr_db\tspeed\tfillers_per_min\tseed\tduration_sec\tfillers\n";
+
+	uint64_t item_index = 0;
+	for (double snr_db : options.snr_db) {
+		for (double speed : options.speeds) {
+			for (double fillers_per_min : options.fillers_per_min) {
+				for (int i = 0; i < options.count; i++, item_index++) {
+					char index[16];
+					snprintf(index, sizeof(index), "%03d", i);
+					const std::string name = "snr" + format_value(snr_db) +
+								 "_speed" + format_value(speed) +
+								 "_fillers" +
+								 format_value(fillers_per_min) + "_" +
+								 index;
+					// seeded by the name, adding a value to a list does not
+					// change the other files
+					const uint64_t item_seed = name_seed(options.seed, name);
+					corpus_random random(item_seed);
+					std::vector<float> mix;
+					std::vector<placed_clip> placed;
+					build_item(options, random, speech, fillers, noise, snr_db,
+						   speed, fillers_per_min, mix, placed);
+
+					if (!write_wav(out_dir / (name + ".wav"), mix, options.rate)) {
+						fprintf(stderr, "cannot write %s.wav\n", name.c_str());
+						return 1;
+					}
+					std::ofstream truth(out_dir / (name + ".tsv"), std::ios::trunc);
+					truth << "start\tend\tlabel\tclip\n";
+					size_t n_fillers = 0;
+					for (const placed_clip &p : placed) {
+						char line[64];
+						snprintf(line, sizeof(line), "%.3f\t%.3f\t",
+							 (double)p.start / options.rate,
+							 (double)p.end / options.rate);
+						truth << line << p.label << '\t' << p.name << '\n';
+						n_fillers += strcmp(p.label, "filler") == 0;
+					}
+					manifest << name << '\t' << format_value(snr_db) << '\t'
+						 << format_value(speed) << '\t'
+						 << format_value(fillers_per_min) << '\t' << item_seed
+						 << '\t' << format_value(options.duration_sec) << '\t'
+						 << n_fillers << '\n';
+				}
+			}
+		}
+	}
+	fprintf(stderr, "wrote %llu files to %s\n", (unsigned long long)item_index,
+		out_dir.u8string().c_str());
+	return 0;
+}
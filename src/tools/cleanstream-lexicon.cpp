@@ -0,0 +1,100 @@
+// Compile a word list into a lexicon file for the filter's "Lexicon file" setting, e.g.
+//   cleanstream-lexicon blocklist.txt blocklist.lexicon
+// One phrase per line, optionally prefixed by its action and a tab: "beep\tsome phrase" or
+// "filler\tuh huh". Lines without an action get --action, empty lines and lines starting with
+// # are skipped. The output replaces the file atomically, filters using it pick it up within
+// a second.
+
+#include "whisper-utils/detection.h"
+#include "whisper-utils/lexicon.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+void usage()
+{
+	fprintf(stderr, "usage: cleanstream-lexicon [--action <beep|filler>] <word list> <output>\n"
+			"  --action <beep|filler>   action of phrases without one (beep)\n");
+}
+
+// "beep" or "filler", -1 otherwise
+int parse_action(const std::string &name)
+{
+	if (name == "beep") {
+		return DETECTION_RESULT_BEEP;
+	}
+	if (name == "filler") {
+		return DETECTION_RESULT_FILLER;
+	}
+	return -1;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	int default_action = DETECTION_RESULT_BEEP;
+	std::vector<std::string> paths;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--action") == 0 && i + 1 < argc) {
+			default_action = parse_action(argv[++i]);
+			if (default_action < 0) {
+				usage();
+				return 2;
+			}
+		} else {
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.size() != 2) {
+		usage();
+		return 2;
+	}
+
+	std::ifstream input(paths[0]);
+	if (!input.is_open()) {
+		fprintf(stderr, "cannot read %s\n", paths[0].c_str());
+		return 1;
+	}
+	std::vector<lexicon_source_entry> entries;
+	std::string line;
+	size_t line_number = 0;
+	while (std::getline(input, line)) {
+		line_number++;
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		lexicon_source_entry entry = {line, default_action};
+		const size_t tab = line.find('\t');
+		if (tab != std::string::npos) {
+			entry.result = parse_action(line.substr(0, tab));
+			entry.phrase = line.substr(tab + 1);
+			if (entry.result < 0) {
+				fprintf(stderr, "%s:%zu: unknown action %s\n", paths[0].c_str(),
+					line_number, line.substr(0, tab).c_str());
+				return 1;
+			}
+		}
+		entries.push_back(entry);
+	}
+
+	const std::vector<uint8_t> image = lexicon_compile(entries);
+	std::string error;
+	if (!lexicon_write(paths[1], image, error)) {
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+	const lexicon_header *header = reinterpret_cast<const lexicon_header *>(image.data());
+	fprintf(stderr, "%s: %u phrases of up to %u words from %zu lines, %zu bytes\n",
+		paths[1].c_str(), header->entry_count, header->max_words, entries.size(),
+		image.size());
+	return 0;
+}
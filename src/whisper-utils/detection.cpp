@@ -0,0 +1,186 @@
+#include "detection.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+
+const char *detection_result_name(int result)
+{
+	switch (result) {
+	case DETECTION_RESULT_SILENCE:
+		return "silence";
+	case DETECTION_RESULT_SPEECH:
+		return "speech";
+	case DETECTION_RESULT_FILLER:
+		return "filler";
+	case DETECTION_RESULT_BEEP:
+		return "beep";
+	default:
+		return "unknown";
+	}
+}
+
+// Uppercase letters, sorted: either a range moved by delta, or a range alternating upper and
+// lowercase letters starting with an uppercase one
+struct case_range {
+	uint32_t first;
+	uint32_t last;
+	int32_t delta;
+	bool alternating;
+};
+
+static const case_range case_ranges[] = {
+	{0x0041, 0x005a, 32, false},    // Basic Latin
+	{0x00c0, 0x00d6, 32, false},    // Latin-1
+	{0x00d8, 0x00de, 32, false},    //
+	{0x0100, 0x012f, 0, true},      // Latin Extended-A
+	{0x0130, 0x0130, -199, false},  // I with dot above to i
+	{0x0132, 0x0137, 0, true},      //
+	{0x0139, 0x0148, 0, true},      //
+	{0x014a, 0x0177, 0, true},      //
+	{0x0178, 0x0178, -121, false},  // Y with diaeresis
+	{0x0179, 0x017e, 0, true},      //
+	{0x01cd, 0x01dc, 0, true},      // Latin Extended-B, pinyin
+	{0x01de, 0x01ef, 0, true},      //
+	{0x01f8, 0x021f, 0, true},      // Romanian comma below
+	{0x0222, 0x0233, 0, true},      //
+	{0x0386, 0x0386, 38, false},    // Greek with tonos
+	{0x0388, 0x038a, 37, false},    //
+	{0x038c, 0x038c, 64, false},    //
+	{0x038e, 0x038f, 63, false},    //
+	{0x0391, 0x03a1, 32, false},    // Greek
+	{0x03a3, 0x03ab, 32, false},    //
+	{0x0400, 0x040f, 80, false},    // Cyrillic
+	{0x0410, 0x042f, 32, false},    //
+	{0x0460, 0x0481, 0, true},      //
+	{0x048a, 0x04bf, 0, true},      //
+	{0x04c1, 0x04ce, 0, true},      //
+	{0x04d0, 0x052f, 0, true},      //
+	{0x0531, 0x0556, 48, false},    // Armenian
+	{0x10a0, 0x10c5, 7264, false},  // Georgian Asomtavruli
+	{0x1c90, 0x1cba, -3008, false}, // Georgian Mtavruli
+	{0x1cbd, 0x1cbf, -3008, false}, //
+	{0x1e00, 0x1e95, 0, true},      // Latin Extended Additional, Vietnamese
+	{0x1e9e, 0x1e9e, -7615, false}, // capital sharp s
+	{0x1ea0, 0x1eff, 0, true},      //
+	{0xff21, 0xff3a, 32, false},    // fullwidth Latin
+};
+
+static uint32_t lowercase_code_point(uint32_t cp)
+{
+	for (const case_range &range : case_ranges) {
+		if (cp < range.first) {
+			break;
+		}
+		if (cp <= range.last) {
+			if (range.alternating) {
+				return (cp - range.first) % 2 == 0 ? cp + 1 : cp;
+			}
+			return (uint32_t)((int32_t)cp + range.delta);
+		}
+	}
+	return cp;
+}
+
+static void append_utf8(std::string &out, uint32_t cp)
+{
+	if (cp < 0x80) {
+		out += (char)cp;
+	} else if (cp < 0x800) {
+		out += (char)(0xc0 | (cp >> 6));
+		out += (char)(0x80 | (cp & 0x3f));
+	} else if (cp < 0x10000) {
+		out += (char)(0xe0 | (cp >> 12));
+		out += (char)(0x80 | ((cp >> 6) & 0x3f));
+		out += (char)(0x80 | (cp & 0x3f));
+	} else {
+		out += (char)(0xf0 | (cp >> 18));
+		out += (char)(0x80 | ((cp >> 12) & 0x3f));
+		out += (char)(0x80 | ((cp >> 6) & 0x3f));
+		out += (char)(0x80 | (cp & 0x3f));
+	}
+}
+
+std::string utf8_lowercase(const std::string &text)
+{
+	std::string lower;
+	lower.reserve(text.size());
+	size_t i = 0;
+	while (i < text.size()) {
+		const unsigned char lead = (unsigned char)text[i];
+		if (lead < 0x80) {
+			lower += (char)(lead >= 'A' && lead <= 'Z' ? lead - 'A' + 'a' : lead);
+			i++;
+			continue;
+		}
+		const size_t length = lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : lead >= 0xc0 ? 2 : 1;
+		uint32_t cp = lead & (0xff >> (length + 1));
+		bool valid = length > 1 && i + length <= text.size();
+		for (size_t k = 1; valid && k < length; k++) {
+			const unsigned char next = (unsigned char)text[i + k];
+			valid = (next & 0xc0) == 0x80;
+			cp = (cp << 6) | (next & 0x3f);
+		}
+		if (!valid) {
+			lower += (char)lead;
+			i++;
+			continue;
+		}
+		append_utf8(lower, lowercase_code_point(cp));
+		i += length;
+	}
+	return lower;
+}
+
+std::string normalize_text(const char *text)
+{
+	// convert text to lowercase
+	std::string text_lower = utf8_lowercase(text);
+	// trim whitespace (use lambda)
+	text_lower.erase(std::find_if(text_lower.rbegin(), text_lower.rend(),
+				      [](unsigned char ch) { return !std::isspace(ch); })
+				 .base(),
+			 text_lower.end());
+	return text_lower;
+}
+
+int classify_text(const std::string &text_lower, const std::regex *filler_regex,
+		  const std::regex *beep_regex, std::string *matched)
+{
+	if (text_lower.empty()) {
+		return DETECTION_RESULT_SILENCE;
+	}
+
+	std::smatch filler_match;
+	std::smatch beep_match;
+	const bool has_filler = filler_regex != nullptr &&
+				std::regex_search(text_lower, filler_match, *filler_regex);
+	const bool has_beep = beep_regex != nullptr &&
+			      std::regex_search(text_lower, beep_match, *beep_regex);
+	if (!has_filler && !has_beep) {
+		return DETECTION_RESULT_SPEECH;
+	}
+	if (matched != nullptr) {
+		*matched = has_filler ? filler_match.str() : beep_match.str();
+	}
+	return has_filler ? DETECTION_RESULT_FILLER : DETECTION_RESULT_BEEP;
+}
+
+int classify_prefix(const std::string &text_lower, const std::regex *filler_regex,
+		    const std::regex *beep_regex)
+{
+	// a match decides once the next token cannot continue it
+	auto settled = [&text_lower](const std::regex *regex) {
+		std::smatch match;
+		return regex != nullptr && std::regex_search(text_lower, match, *regex) &&
+		       (size_t)(match.position(0) + match.length(0)) < text_lower.size();
+	};
+	if (settled(filler_regex)) {
+		return DETECTION_RESULT_FILLER;
+	}
+	// a filler later in the text would still win over the beep
+	if (filler_regex == nullptr && settled(beep_regex)) {
+		return DETECTION_RESULT_BEEP;
+	}
+	return DETECTION_RESULT_UNKNOWN;
+}
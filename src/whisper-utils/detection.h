@@ -0,0 +1,36 @@
+#ifndef DETECTION_H
+#define DETECTION_H
+
+#include <regex>
+#include <string>
+
+enum DetectionResult {
+	DETECTION_RESULT_UNKNOWN = 0,
+	DETECTION_RESULT_SILENCE = 1,
+	DETECTION_RESULT_SPEECH = 2,
+	DETECTION_RESULT_FILLER = 3,
+	DETECTION_RESULT_BEEP = 4,
+};
+
+const char *detection_result_name(int result);
+
+// Lowercase UTF-8 text with the simple case mappings of the Latin, Greek, Cyrillic, Armenian
+// and Georgian scripts. Invalid bytes are kept as they are.
+std::string utf8_lowercase(const std::string &text);
+
+// Lowercase and trim a whisper transcription
+std::string normalize_text(const char *text);
+
+// Classify a normalized transcription, either expression may be null. A filler wins over a
+// beep. matched receives the text it matched.
+int classify_text(const std::string &text_lower, const std::regex *filler_regex,
+		  const std::regex *beep_regex, std::string *matched = nullptr);
+
+// The result classify_text gives every transcription starting with this partial one, or
+// DETECTION_RESULT_UNKNOWN while the rest of the text can still change it. A match reaching
+// the end of the partial text is not final yet, the next token may continue its word. A beep
+// is only final without a filler expression, a filler decoded later would win.
+int classify_prefix(const std::string &text_lower, const std::regex *filler_regex,
+		    const std::regex *beep_regex);
+
+#endif // DETECTION_H
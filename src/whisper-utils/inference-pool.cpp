@@ -0,0 +1,320 @@
+#include "inference-pool.h"
+#include "inference-thread.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define INFERENCE_PRIORITY_COUNT 3
+// how long an idle worker spins for new work before it parks
+#define SPIN_NS 200000ULL
+// how often the housekeeping callbacks run
+#define HOUSEKEEPING_INTERVAL_NS 1000000000ULL
+// threads started to measure what a thread per job would cost instead of the pool
+#define THREAD_START_SAMPLES 16
+
+namespace {
+
+struct pool_job {
+	std::function<void(bool cancelled)> run;
+	int n_threads;
+	uint64_t submit_ns;
+};
+
+struct worker_set {
+	std::deque<pool_job> queue;
+	std::vector<std::thread> threads;
+	std::condition_variable cv;
+	std::atomic<int> queued{0};
+	// workers parked on the condition variable and workers spinning for work
+	int parked = 0;
+	int spinning = 0;
+	// workers running a job and the compute threads of their jobs, and the workers blocked
+	// in inference_pool_wait, which are not counted as running
+	int running = 0;
+	int running_threads = 0;
+	int blocked = 0;
+};
+
+struct inference_pool {
+	std::mutex mutex;
+	worker_set sets[INFERENCE_PRIORITY_COUNT];
+	bool stopping = false;
+	uint64_t last_housekeeping_ns = 0;
+
+	std::mutex housekeeping_mutex;
+	std::map<void *, std::function<void()>> housekeeping;
+
+	// dispatch statistics, logged on shutdown
+	uint64_t jobs = 0;
+	uint64_t jobs_from_spin = 0;
+	uint64_t dispatch_ns = 0;
+	uint64_t max_dispatch_ns = 0;
+	// median time to start and join a thread, measured by the first worker
+	std::atomic<uint64_t> thread_start_ns{0};
+};
+
+inference_pool pool;
+// the priority of the worker running on this thread, -1 on other threads, and the compute
+// threads of its job
+thread_local int worker_priority = -1;
+thread_local int worker_job_threads = 0;
+
+int core_count()
+{
+	return (int)std::max(1u, std::thread::hardware_concurrency());
+}
+
+// What starting a thread for every job would add to its dispatch latency
+uint64_t measure_thread_start_ns()
+{
+	std::vector<uint64_t> samples;
+	for (int i = 0; i < THREAD_START_SAMPLES; i++) {
+		const uint64_t start_ns = os_gettime_ns();
+		std::thread([] {}).join();
+		samples.push_back(os_gettime_ns() - start_ns);
+	}
+	std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+	return samples[samples.size() / 2];
+}
+
+// Called with the pool mutex held. Every inference runs whisper's own compute threads: a job
+// starts if its threads fit into the cores next to the running ones, more would just compete
+// for the same cores. A job runs alone if it needs more.
+bool can_take_job(const worker_set &set)
+{
+	return !set.queue.empty() &&
+	       (set.running == 0 ||
+		set.running_threads + set.queue.front().n_threads <= core_count());
+}
+
+// called with the pool mutex held, a job runs at least one compute thread and blocked workers
+// do not count against the limit
+bool can_start_worker(const worker_set &set)
+{
+	return set.threads.size() < (size_t)core_count() + (size_t)set.blocked;
+}
+
+bool spin_for_job(worker_set &set)
+{
+	const uint64_t end_ns = os_gettime_ns() + SPIN_NS;
+	while (os_gettime_ns() < end_ns) {
+		if (set.queued > 0) {
+			return true;
+		}
+		std::this_thread::yield();
+	}
+	return false;
+}
+
+void run_housekeeping_if_due(std::unique_lock<std::mutex> &lock)
+{
+	const uint64_t now = os_gettime_ns();
+	if (now - pool.last_housekeeping_ns < HOUSEKEEPING_INTERVAL_NS) {
+		return;
+	}
+	pool.last_housekeeping_ns = now;
+
+	lock.unlock();
+	{
+		std::lock_guard<std::mutex> housekeeping_lock(pool.housekeeping_mutex);
+		for (auto &entry : pool.housekeeping) {
+			entry.second();
+		}
+	}
+	lock.lock();
+}
+
+void worker_loop(int priority)
+{
+	os_set_thread_name("cleanstream-inference");
+	apply_inference_thread_priority(priority);
+	worker_priority = priority;
+	if (pool.thread_start_ns == 0) {
+		pool.thread_start_ns = measure_thread_start_ns();
+	}
+
+	worker_set &set = pool.sets[priority];
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	while (!pool.stopping) {
+		bool from_spin = false;
+		if (!can_take_job(set)) {
+			set.spinning++;
+			lock.unlock();
+			from_spin = spin_for_job(set);
+			lock.lock();
+			set.spinning--;
+
+			if (!can_take_job(set) && !pool.stopping) {
+				from_spin = false;
+				set.parked++;
+				set.cv.wait_for(lock, std::chrono::nanoseconds(HOUSEKEEPING_INTERVAL_NS),
+						[&set] { return pool.stopping || can_take_job(set); });
+				set.parked--;
+			}
+			if (!can_take_job(set)) {
+				run_housekeeping_if_due(lock);
+				continue;
+			}
+		}
+
+		pool_job job = std::move(set.queue.front());
+		set.queue.pop_front();
+		set.queued--;
+
+		const uint64_t dispatch_ns = os_gettime_ns() - job.submit_ns;
+		pool.jobs++;
+		pool.jobs_from_spin += from_spin ? 1 : 0;
+		pool.dispatch_ns += dispatch_ns;
+		pool.max_dispatch_ns = std::max(pool.max_dispatch_ns, dispatch_ns);
+
+		set.running++;
+		set.running_threads += job.n_threads;
+		worker_job_threads = job.n_threads;
+		lock.unlock();
+		job.run(false);
+		lock.lock();
+		set.running--;
+		set.running_threads -= job.n_threads;
+		if (can_take_job(set) && set.parked > 0 && set.spinning == 0) {
+			// a job waited for the running ones to drop below the limit
+			set.cv.notify_one();
+		}
+	}
+}
+
+// called with the pool mutex held
+void start_worker(int priority)
+{
+	worker_set &set = pool.sets[priority];
+	set.threads.emplace_back(worker_loop, priority);
+	obs_log(LOG_INFO, "Started inference worker %d with priority %d", (int)set.threads.size(),
+		priority);
+}
+
+} // namespace
+
+void inference_pool_submit(int priority, int n_threads, std::function<void(bool cancelled)> job)
+{
+	priority = std::clamp(priority, 0, INFERENCE_PRIORITY_COUNT - 1);
+	worker_set &set = pool.sets[priority];
+
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	if (pool.stopping) {
+		lock.unlock();
+		job(true);
+		return;
+	}
+	set.queue.push_back({std::move(job), std::max(1, n_threads), os_gettime_ns()});
+	set.queued++;
+
+	if (set.spinning > 0) {
+		// a spinning worker picks it up without a wakeup
+		return;
+	}
+	if (set.parked > 0) {
+		set.cv.notify_one();
+	} else if (can_start_worker(set)) {
+		start_worker(priority);
+	}
+}
+
+void inference_pool_wait(const std::function<void()> &wait)
+{
+	if (worker_priority < 0) {
+		wait();
+		return;
+	}
+	worker_set &set = pool.sets[worker_priority];
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		set.running--;
+		set.running_threads -= worker_job_threads;
+		set.blocked++;
+		if (can_take_job(set) && set.spinning == 0) {
+			if (set.parked > 0) {
+				set.cv.notify_one();
+			} else if (!pool.stopping && can_start_worker(set)) {
+				start_worker(worker_priority);
+			}
+		}
+	}
+	wait();
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	set.blocked--;
+	set.running++;
+	set.running_threads += worker_job_threads;
+}
+
+void inference_pool_add_housekeeping(void *owner, std::function<void()> callback)
+{
+	{
+		std::lock_guard<std::mutex> lock(pool.housekeeping_mutex);
+		pool.housekeeping[owner] = std::move(callback);
+	}
+
+	// make sure there is a worker to run it
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	bool has_workers = false;
+	for (const worker_set &set : pool.sets) {
+		has_workers = has_workers || !set.threads.empty();
+	}
+	if (!has_workers && !pool.stopping) {
+		start_worker(INFERENCE_PRIORITY_BELOW_NORMAL);
+	}
+}
+
+void inference_pool_remove_housekeeping(void *owner)
+{
+	std::lock_guard<std::mutex> lock(pool.housekeeping_mutex);
+	pool.housekeeping.erase(owner);
+}
+
+void inference_pool_shutdown()
+{
+	std::vector<std::thread> threads;
+	std::vector<pool_job> cancelled;
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.stopping = true;
+		for (worker_set &set : pool.sets) {
+			set.cv.notify_all();
+			for (std::thread &thread : set.threads) {
+				threads.push_back(std::move(thread));
+			}
+			set.threads.clear();
+			for (pool_job &job : set.queue) {
+				cancelled.push_back(std::move(job));
+			}
+			set.queue.clear();
+			set.queued = 0;
+		}
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+	for (pool_job &job : cancelled) {
+		job.run(true);
+	}
+
+	if (pool.jobs > 0) {
+		obs_log(LOG_INFO,
+			"Inference pool: %d workers ran %llu jobs, dispatch latency avg %.1f us, max %.1f us, %.1f%% picked up while spinning, a thread per job would add %.1f us",
+			(int)threads.size(), (unsigned long long)pool.jobs,
+			(double)pool.dispatch_ns / (double)pool.jobs / 1000.0,
+			(double)pool.max_dispatch_ns / 1000.0,
+			100.0 * (double)pool.jobs_from_spin / (double)pool.jobs,
+			(double)pool.thread_start_ns / 1000.0);
+	}
+}
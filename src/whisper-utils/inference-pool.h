@@ -0,0 +1,33 @@
+#ifndef INFERENCE_POOL_H
+#define INFERENCE_POOL_H
+
+#include <functional>
+
+// Process wide pool of persistent inference workers shared by all filter instances.
+// Workers are grouped by inference_priority since the priority can only be lowered, it is
+// applied once when a worker starts. Jobs of a priority run at the same time as long as the
+// sum of their whisper compute threads fits into the cores. An idle worker spins for a short
+// while before it parks, so the next segment of a steady stream is picked up without a wakeup.
+//
+// The workers only replace the thread per job. whisper.cpp 1.5 still starts and joins its
+// n_threads compute threads in ggml for every graph it computes.
+
+// Queue a job running n_threads whisper compute threads for a worker of the given priority. A
+// job submitted or still queued while the pool shuts down is called with cancelled set
+// instead, on the calling thread, so its owner still learns that it finished.
+void inference_pool_submit(int priority, int n_threads, std::function<void(bool cancelled)> job);
+
+// Call wait, a blocking call that leaves the CPU to others such as waiting for another job,
+// without counting the calling worker against the concurrent inferences of its priority: a
+// queued job may start on another worker meanwhile. On other threads wait is just called.
+void inference_pool_wait(const std::function<void()> &wait);
+
+// Run the callback about once a second on a pool worker until it is removed.
+// Removing waits for a running callback to return.
+void inference_pool_add_housekeeping(void *owner, std::function<void()> callback);
+void inference_pool_remove_housekeeping(void *owner);
+
+// Stop and join all workers, called when the module unloads
+void inference_pool_shutdown();
+
+#endif // INFERENCE_POOL_H
@@ -0,0 +1,280 @@
+#include "inference-thread.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <pthread/qos.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <time.h>
+
+// CPU numbers from 0 to this are accepted, CPU_SETSIZE of glibc
+#define MAX_CPUS 1024
+
+// Parse a CPU list like "0-3,8,10-11", the format used by taskset and sysfs
+static std::vector<int> parse_cpu_list(const std::string &list)
+{
+	std::vector<int> cpus;
+	std::stringstream ss(list);
+	std::string range;
+	while (std::getline(ss, range, ',')) {
+		range.erase(std::remove_if(range.begin(), range.end(),
+					   [](unsigned char c) { return std::isspace(c); }),
+			    range.end());
+		if (range.empty()) {
+			continue;
+		}
+		try {
+			const size_t dash = range.find('-');
+			const int first = std::stoi(range.substr(0, dash));
+			const int last = dash == std::string::npos ? first
+								   : std::stoi(range.substr(dash + 1));
+			if (first < 0 || last < first || last >= MAX_CPUS) {
+				obs_log(LOG_WARNING, "Ignoring CPU range '%s', CPUs go from 0 to %d",
+					range.c_str(), MAX_CPUS - 1);
+				continue;
+			}
+			for (int cpu = first; cpu <= last; cpu++) {
+				cpus.push_back(cpu);
+			}
+		} catch (const std::exception &) {
+			obs_log(LOG_WARNING, "Ignoring invalid CPU range '%s'", range.c_str());
+		}
+	}
+	std::sort(cpus.begin(), cpus.end());
+	cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+	return cpus;
+}
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+
+static std::string read_sysfs(const std::string &path)
+{
+	std::ifstream file(path);
+	std::string value;
+	std::getline(file, value);
+	return value;
+}
+
+static bool is_first_core_sibling(int cpu)
+{
+	const std::vector<int> siblings = parse_cpu_list(read_sysfs(
+		"/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list"));
+	return siblings.empty() || siblings.front() == cpu;
+}
+
+// Returns the NUMA node all CPUs belong to, -1 on single node hosts or if they span nodes
+static int numa_node_of_cpus(const std::vector<int> &cpus)
+{
+	const std::vector<int> nodes = parse_cpu_list(read_sysfs("/sys/devices/system/node/online"));
+	if (nodes.size() < 2) {
+		return -1;
+	}
+	for (int node : nodes) {
+		const std::vector<int> node_cpus = parse_cpu_list(read_sysfs(
+			"/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+		if (std::includes(node_cpus.begin(), node_cpus.end(), cpus.begin(), cpus.end())) {
+			return node;
+		}
+	}
+	return -1;
+}
+
+static void set_preferred_numa_node(int node)
+{
+	// set_mempolicy(2) without a libnuma dependency
+	const int MPOL_DEFAULT_ = 0;
+	const int MPOL_PREFERRED_ = 1;
+	unsigned long mask = 0;
+	long result;
+	if (node >= 0 && node < (int)(sizeof(mask) * 8)) {
+		mask = 1UL << node;
+		result = syscall(SYS_set_mempolicy, MPOL_PREFERRED_, &mask, sizeof(mask) * 8 + 1);
+	} else {
+		result = syscall(SYS_set_mempolicy, MPOL_DEFAULT_, nullptr, 0);
+	}
+	if (result != 0) {
+		obs_log(LOG_WARNING, "Failed to set the memory policy for NUMA node %d", node);
+	}
+}
+
+inference_thread_placement apply_inference_thread_placement(const inference_thread_config &config)
+{
+	inference_thread_placement placement;
+
+	std::vector<int> cpus = parse_cpu_list(config.cpu_set);
+	if (cpus.empty() && config.physical_cores_only) {
+		cpus = parse_cpu_list(read_sysfs("/sys/devices/system/cpu/online"));
+	}
+	if (config.physical_cores_only) {
+		cpus.erase(std::remove_if(cpus.begin(), cpus.end(),
+					  [](int cpu) { return !is_first_core_sibling(cpu); }),
+			   cpus.end());
+	}
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (cpus.empty()) {
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			CPU_SET(cpu, &set);
+		}
+	} else {
+		for (int cpu : cpus) {
+			if (cpu < CPU_SETSIZE) {
+				CPU_SET(cpu, &set);
+			}
+		}
+		placement.n_cpus = (int)cpus.size();
+	}
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+		obs_log(LOG_WARNING, "Failed to set the inference thread affinity to '%s'",
+			config.cpu_set.c_str());
+		placement.n_cpus = 0;
+	}
+
+	placement.numa_node = cpus.empty() ? -1 : numa_node_of_cpus(cpus);
+	set_preferred_numa_node(placement.numa_node);
+
+	return placement;
+}
+
+void apply_inference_thread_priority(int priority)
+{
+	// SCHED_IDLE for the lowest priority, otherwise a nice value on the normal scheduler
+	if (priority == INFERENCE_PRIORITY_LOWEST) {
+		struct sched_param param = {};
+		if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {
+			obs_log(LOG_WARNING, "Failed to set the inference thread scheduling policy");
+		}
+	} else if (priority == INFERENCE_PRIORITY_BELOW_NORMAL) {
+		if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10) != 0) {
+			obs_log(LOG_WARNING, "Failed to set the inference thread nice value");
+		}
+	}
+}
+
+#elif defined(_WIN32)
+
+inference_thread_placement apply_inference_thread_placement(const inference_thread_config &config)
+{
+	inference_thread_placement placement;
+
+	DWORD_PTR process_mask = 0;
+	DWORD_PTR system_mask = 0;
+	GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask);
+
+	DWORD_PTR mask = 0;
+	for (int cpu : parse_cpu_list(config.cpu_set)) {
+		if (cpu < (int)(sizeof(DWORD_PTR) * 8)) {
+			mask |= (DWORD_PTR)1 << cpu;
+		}
+	}
+	if (mask == 0) {
+		mask = process_mask;
+	}
+
+	if (config.physical_cores_only) {
+		// keep the lowest logical processor of every core
+		DWORD length = 0;
+		GetLogicalProcessorInformation(nullptr, &length);
+		std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(
+			length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+		if (!info.empty() && GetLogicalProcessorInformation(info.data(), &length)) {
+			DWORD_PTR physical_mask = 0;
+			for (const auto &item : info) {
+				if (item.Relationship == RelationProcessorCore) {
+					physical_mask |= item.ProcessorMask & (~item.ProcessorMask + 1);
+				}
+			}
+			mask &= physical_mask;
+		}
+	}
+
+	mask &= process_mask;
+	if (mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0) {
+		if (mask != process_mask) {
+			for (DWORD_PTR m = mask; m != 0; m &= m - 1) {
+				placement.n_cpus++;
+			}
+		}
+	} else {
+		obs_log(LOG_WARNING, "Failed to set the inference thread affinity to '%s'",
+			config.cpu_set.c_str());
+	}
+
+	return placement;
+}
+
+void apply_inference_thread_priority(int priority)
+{
+	const int thread_priority = priority == INFERENCE_PRIORITY_LOWEST ? THREAD_PRIORITY_LOWEST
+				    : priority == INFERENCE_PRIORITY_BELOW_NORMAL
+					    ? THREAD_PRIORITY_BELOW_NORMAL
+					    : THREAD_PRIORITY_NORMAL;
+	if (!SetThreadPriority(GetCurrentThread(), thread_priority)) {
+		obs_log(LOG_WARNING, "Failed to set the inference thread priority");
+	}
+}
+
+#else
+
+inference_thread_placement apply_inference_thread_placement(const inference_thread_config &config)
+{
+	// macOS has no thread affinity API
+	if (!config.cpu_set.empty() || config.physical_cores_only) {
+		obs_log(LOG_INFO, "CPU placement of the inference threads is not supported on macOS");
+	}
+	return inference_thread_placement();
+}
+
+void apply_inference_thread_priority(int priority)
+{
+	// use the QoS classes for the priority
+	const qos_class_t qos = priority == INFERENCE_PRIORITY_LOWEST ? QOS_CLASS_BACKGROUND
+				: priority == INFERENCE_PRIORITY_BELOW_NORMAL ? QOS_CLASS_UTILITY
+									      : QOS_CLASS_USER_INITIATED;
+	if (pthread_set_qos_class_self_np(qos, 0) != 0) {
+		obs_log(LOG_WARNING, "Failed to set the inference thread QoS class");
+	}
+}
+
+#endif
+
+uint64_t process_cpu_time_ns()
+{
+#ifdef _WIN32
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time,
+			     &user_time)) {
+		return 0;
+	}
+	// in 100 ns units
+	const uint64_t kernel = ((uint64_t)kernel_time.dwHighDateTime << 32) |
+				kernel_time.dwLowDateTime;
+	const uint64_t user = ((uint64_t)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime;
+	return (kernel + user) * 100;
+#else
+	struct timespec ts;
+	if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0) {
+		return 0;
+	}
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
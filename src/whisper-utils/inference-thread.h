@@ -0,0 +1,52 @@
+#ifndef INFERENCE_THREAD_H
+#define INFERENCE_THREAD_H
+
+#include <cstdint>
+#include <string>
+
+enum inference_priority {
+	INFERENCE_PRIORITY_NORMAL = 0,
+	INFERENCE_PRIORITY_BELOW_NORMAL = 1,
+	INFERENCE_PRIORITY_LOWEST = 2,
+};
+
+// Where and how the inference threads run
+struct inference_thread_config {
+	// CPU list like "0-3,8,10", empty means any CPU
+	std::string cpu_set;
+	// keep only the first hardware thread of each core in the set
+	bool physical_cores_only = false;
+	int priority = INFERENCE_PRIORITY_NORMAL;
+
+	bool operator==(const inference_thread_config &other) const
+	{
+		return cpu_set == other.cpu_set && physical_cores_only == other.physical_cores_only &&
+		       priority == other.priority;
+	}
+	bool operator!=(const inference_thread_config &other) const { return !(*this == other); }
+};
+
+struct inference_thread_placement {
+	// number of CPUs the thread may run on, 0 if unrestricted
+	int n_cpus = 0;
+	// NUMA node memory is allocated from, -1 if the default policy is used
+	int numa_node = -1;
+};
+
+// Apply the CPU set and memory policy of the config to the calling thread.
+// On Linux threads created afterwards from this thread (whisper's compute threads) inherit
+// the affinity and memory policy, and memory allocated afterwards (the model weights and
+// states) is placed on the NUMA node of the CPU set. On Windows only the calling thread is
+// placed and macOS has no affinity API.
+inference_thread_placement apply_inference_thread_placement(const inference_thread_config &config);
+
+// Apply the priority to the calling thread. Unprivileged processes cannot raise it again
+// afterwards, so this is done once when an inference worker starts.
+void apply_inference_thread_priority(int priority);
+
+// CPU time used by all threads of the process so far. Whisper runs its compute threads next
+// to the calling one, so the CPU time of an inference is measured on the whole process and
+// includes whatever else runs at the same time.
+uint64_t process_cpu_time_ns();
+
+#endif // INFERENCE_THREAD_H
@@ -0,0 +1,353 @@
+#include "lexicon.h"
+#include "detection.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+struct lexicon {
+	const uint8_t *data = nullptr;
+	size_t size = 0;
+	const lexicon_header *header = nullptr;
+	const uint32_t *slots = nullptr;
+	const lexicon_entry *entries = nullptr;
+	const char *text = nullptr;
+	// the file that was mapped
+	fs::file_time_type write_time;
+	uintmax_t file_size = 0;
+
+	~lexicon()
+	{
+		if (data == nullptr) {
+			return;
+		}
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+#else
+		munmap((void *)data, size);
+#endif
+	}
+};
+
+static std::mutex lexicons_mutex;
+static std::map<std::string, std::weak_ptr<const lexicon>> lexicons;
+
+static uint64_t fnv1a(uint64_t hash, const char *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		hash ^= (uint8_t)data[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+static bool is_word_byte(unsigned char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+	       c == '\'' || c >= 0x80;
+}
+
+std::vector<std::pair<size_t, size_t>> lexicon_split_words(const std::string &text)
+{
+	std::vector<std::pair<size_t, size_t>> words;
+	size_t i = 0;
+	while (i < text.size()) {
+		while (i < text.size() && !is_word_byte((unsigned char)text[i])) {
+			i++;
+		}
+		const size_t start = i;
+		while (i < text.size() && is_word_byte((unsigned char)text[i])) {
+			i++;
+		}
+		if (i > start) {
+			words.emplace_back(start, i - start);
+		}
+	}
+	return words;
+}
+
+template<typename T> static void append_pod(std::vector<uint8_t> &image, const T &value)
+{
+	const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+	image.insert(image.end(), bytes, bytes + sizeof(T));
+}
+
+std::vector<uint8_t> lexicon_compile(const std::vector<lexicon_source_entry> &source)
+{
+	std::vector<lexicon_entry> entries;
+	std::string text;
+	std::unordered_map<std::string, size_t> seen;
+	uint32_t max_words = 0;
+	for (const lexicon_source_entry &source_entry : source) {
+		// the same lowercasing as normalize_text
+		const std::string lower = utf8_lowercase(source_entry.phrase);
+		std::string phrase;
+		const auto words = lexicon_split_words(lower);
+		for (const auto &word : words) {
+			if (!phrase.empty()) {
+				phrase += ' ';
+			}
+			phrase.append(lower, word.first, word.second);
+		}
+		if (phrase.empty() || !seen.emplace(phrase, entries.size()).second) {
+			continue;
+		}
+		lexicon_entry entry = {};
+		entry.hash = fnv1a(FNV_OFFSET_BASIS, phrase.data(), phrase.size());
+		entry.text_offset = (uint32_t)text.size();
+		entry.text_size = (uint32_t)phrase.size();
+		entry.result = (uint32_t)source_entry.result;
+		entries.push_back(entry);
+		text += phrase;
+		max_words = std::max(max_words, (uint32_t)words.size());
+	}
+
+	// at most half full, probe sequences stay short
+	uint32_t slot_count = 2;
+	while (slot_count < entries.size() * 2) {
+		slot_count *= 2;
+	}
+	std::vector<uint32_t> slots(slot_count, 0);
+	for (size_t i = 0; i < entries.size(); i++) {
+		size_t slot = entries[i].hash & (slot_count - 1);
+		while (slots[slot] != 0) {
+			slot = (slot + 1) & (slot_count - 1);
+		}
+		slots[slot] = (uint32_t)i + 1;
+	}
+
+	lexicon_header header = {};
+	header.magic = LEXICON_MAGIC;
+	header.version = LEXICON_VERSION;
+	header.entry_count = (uint32_t)entries.size();
+	header.slot_count = slot_count;
+	header.max_words = max_words;
+	header.text_size = text.size();
+
+	std::vector<uint8_t> image;
+	image.reserve(sizeof(header) + slots.size() * sizeof(uint32_t) +
+		      entries.size() * sizeof(lexicon_entry) + text.size());
+	append_pod(image, header);
+	for (uint32_t slot : slots) {
+		append_pod(image, slot);
+	}
+	for (const lexicon_entry &entry : entries) {
+		append_pod(image, entry);
+	}
+	image.insert(image.end(), text.begin(), text.end());
+	return image;
+}
+
+bool lexicon_write(const std::string &path, const std::vector<uint8_t> &image,
+		   std::string &error)
+{
+	const fs::path target = fs::u8path(path);
+	fs::path tmp = target;
+	tmp += ".tmp";
+	{
+		std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char *>(image.data()), (std::streamsize)image.size());
+		if (!out) {
+			error = "cannot write " + tmp.u8string();
+			return false;
+		}
+	}
+	std::error_code ec;
+	fs::rename(tmp, target, ec);
+	if (ec) {
+		error = "cannot replace " + path + ": " + ec.message();
+		fs::remove(tmp, ec);
+		return false;
+	}
+	return true;
+}
+
+// Map the file read only, returns nullptr if it cannot be opened
+static const uint8_t *map_file(const std::string &path, size_t &size)
+{
+#ifdef _WIN32
+	int count = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), (int)path.length(), NULL, 0);
+	std::wstring path_ws(count, 0);
+	MultiByteToWideChar(CP_UTF8, 0, path.c_str(), (int)path.length(), &path_ws[0], count);
+	// share delete, so the compiler can rename a new file over it
+	HANDLE file = CreateFileW(path_ws.c_str(), GENERIC_READ,
+				  FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+				  FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return nullptr;
+	}
+	LARGE_INTEGER file_size;
+	HANDLE mapping = NULL;
+	if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+		mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	}
+	CloseHandle(file);
+	if (mapping == NULL) {
+		return nullptr;
+	}
+	// the view keeps the mapping alive
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	size = (size_t)file_size.QuadPart;
+	return static_cast<const uint8_t *>(data);
+#else
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return nullptr;
+	}
+	struct stat st;
+	void *data = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (data == MAP_FAILED) {
+		return nullptr;
+	}
+	size = (size_t)st.st_size;
+	return static_cast<const uint8_t *>(data);
+#endif
+}
+
+std::shared_ptr<const lexicon> lexicon_load(const std::string &path, std::string &error)
+{
+	const fs::path file = fs::u8path(path);
+	std::error_code ec;
+	std::string key = fs::weakly_canonical(file, ec).u8string();
+	if (ec) {
+		key = path;
+	}
+	const fs::file_time_type write_time = fs::last_write_time(file, ec);
+	const uintmax_t file_size = ec ? 0 : fs::file_size(file, ec);
+	if (ec) {
+		error = ec.message();
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(lexicons_mutex);
+	auto it = lexicons.find(key);
+	if (it != lexicons.end()) {
+		std::shared_ptr<const lexicon> mapped = it->second.lock();
+		if (mapped && mapped->write_time == write_time && mapped->file_size == file_size) {
+			return mapped;
+		}
+	}
+
+	auto loaded = std::make_shared<lexicon>();
+	loaded->data = map_file(path, loaded->size);
+	if (loaded->data == nullptr) {
+		error = "cannot map the file";
+		return nullptr;
+	}
+	loaded->write_time = write_time;
+	loaded->file_size = file_size;
+
+	// only the header is checked, the entries are checked when they are used
+	const lexicon_header *header = reinterpret_cast<const lexicon_header *>(loaded->data);
+	if (loaded->size < sizeof(lexicon_header) || header->magic != LEXICON_MAGIC) {
+		error = "not a lexicon file";
+		return nullptr;
+	}
+	if (header->version != LEXICON_VERSION) {
+		error = "unsupported lexicon version " + std::to_string(header->version);
+		return nullptr;
+	}
+	const uint64_t expected_size = sizeof(lexicon_header) +
+				       (uint64_t)header->slot_count * sizeof(uint32_t) +
+				       (uint64_t)header->entry_count * sizeof(lexicon_entry) +
+				       header->text_size;
+	if (header->slot_count == 0 || (header->slot_count & (header->slot_count - 1)) != 0 ||
+	    header->entry_count >= header->slot_count || expected_size != loaded->size) {
+		error = "corrupt lexicon file";
+		return nullptr;
+	}
+	loaded->header = header;
+	loaded->slots = reinterpret_cast<const uint32_t *>(loaded->data + sizeof(lexicon_header));
+	loaded->entries =
+		reinterpret_cast<const lexicon_entry *>(loaded->slots + header->slot_count);
+	loaded->text = reinterpret_cast<const char *>(loaded->entries + header->entry_count);
+
+	lexicons[key] = loaded;
+	return loaded;
+}
+
+uint32_t lexicon_entry_count(const lexicon &lexicon)
+{
+	return lexicon.header->entry_count;
+}
+
+// The entry of a phrase, nullptr if it is not in the lexicon
+static const lexicon_entry *find_phrase(const lexicon &lexicon, uint64_t hash,
+					const std::string &phrase)
+{
+	const uint32_t mask = lexicon.header->slot_count - 1;
+	// an empty slot ends the probe, the table is never full
+	for (uint32_t slot = (uint32_t)hash & mask, probes = 0;
+	     lexicon.slots[slot] != 0 && probes <= mask; slot = (slot + 1) & mask, probes++) {
+		const uint32_t index = lexicon.slots[slot] - 1;
+		if (index >= lexicon.header->entry_count) {
+			continue;
+		}
+		const lexicon_entry &entry = lexicon.entries[index];
+		if (entry.hash == hash && entry.text_size == phrase.size() &&
+		    (uint64_t)entry.text_offset + entry.text_size <= lexicon.header->text_size &&
+		    memcmp(lexicon.text + entry.text_offset, phrase.data(), phrase.size()) == 0) {
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+int lexicon_match(const lexicon &lexicon, const std::string &text_lower, std::string *matched)
+{
+	const auto words = lexicon_split_words(text_lower);
+	std::string phrase;
+	for (size_t i = 0; i < words.size(); i++) {
+		// the phrase and its hash grow a word at a time
+		const lexicon_entry *longest = nullptr;
+		size_t longest_size = 0;
+		uint64_t hash = FNV_OFFSET_BASIS;
+		phrase.clear();
+		for (size_t n = 0; n < lexicon.header->max_words && i + n < words.size(); n++) {
+			if (n > 0) {
+				phrase += ' ';
+				hash = fnv1a(hash, " ", 1);
+			}
+			const char *word = text_lower.data() + words[i + n].first;
+			phrase.append(word, words[i + n].second);
+			hash = fnv1a(hash, word, words[i + n].second);
+			const lexicon_entry *entry = find_phrase(lexicon, hash, phrase);
+			if (entry != nullptr) {
+				longest = entry;
+				longest_size = phrase.size();
+			}
+		}
+		if (longest != nullptr) {
+			if (matched != nullptr) {
+				*matched = phrase.substr(0, longest_size);
+			}
+			return longest->result == DETECTION_RESULT_FILLER ? DETECTION_RESULT_FILLER
+									  : DETECTION_RESULT_BEEP;
+		}
+	}
+	return DETECTION_RESULT_SPEECH;
+}
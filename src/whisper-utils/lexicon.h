@@ -0,0 +1,81 @@
+#ifndef LEXICON_H
+#define LEXICON_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Precompiled word lists for block lists too large for a regular expression, built offline
+// with cleanstream-lexicon and memory-mapped by the filter. The file is a hash table of the
+// phrases, so mapping it takes the same time whatever its size, and all filters using the
+// same file share one mapping.
+//
+// File layout, little endian:
+//   lexicon_header
+//   uint32_t slots[slot_count]            entry index + 1, 0 for an empty slot
+//   lexicon_entry entries[entry_count]
+//   char text[text_size]                  the phrases, not terminated
+// A phrase is its lowercase words, as split by lexicon_split_words, joined by single spaces.
+
+#define LEXICON_MAGIC 0x584c5343 // "CSLX"
+// 2: phrases are lowercased beyond ASCII
+#define LEXICON_VERSION 2
+
+struct lexicon_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entry_count;
+	// a power of two
+	uint32_t slot_count;
+	// words of the longest phrase
+	uint32_t max_words;
+	uint32_t reserved;
+	uint64_t text_size;
+};
+
+struct lexicon_entry {
+	// FNV-1a of the phrase
+	uint64_t hash;
+	uint32_t text_offset;
+	uint32_t text_size;
+	// DETECTION_RESULT_FILLER or DETECTION_RESULT_BEEP
+	uint32_t result;
+	uint32_t reserved;
+};
+
+struct lexicon_source_entry {
+	std::string phrase;
+	int result;
+};
+
+struct lexicon;
+
+// Split a normalized transcription into words: runs of ASCII letters, digits, apostrophes
+// and non-ASCII bytes, i.e. UTF-8 letters of other scripts. Returns (offset, size) pairs.
+std::vector<std::pair<size_t, size_t>> lexicon_split_words(const std::string &text);
+
+// Build the file image, phrases are lowercased and split into words the way transcriptions
+// are. Empty phrases are skipped and duplicates keep their first result.
+std::vector<uint8_t> lexicon_compile(const std::vector<lexicon_source_entry> &entries);
+
+// Write the image next to the path and rename it over the file, so a filter mapping the
+// file never sees it half written
+bool lexicon_write(const std::string &path, const std::vector<uint8_t> &image,
+		   std::string &error);
+
+// Map a lexicon file, shared by all callers while the file is unchanged. After the file was
+// replaced the new file is mapped, the old mapping stays valid until its last holder drops
+// it. Returns nullptr and sets error if the file cannot be mapped or is not a lexicon.
+std::shared_ptr<const lexicon> lexicon_load(const std::string &path, std::string &error);
+
+uint32_t lexicon_entry_count(const lexicon &lexicon);
+
+// Find the longest phrase starting at the earliest word of a normalized transcription.
+// Returns the result of the phrase and sets matched, or DETECTION_RESULT_SPEECH.
+int lexicon_match(const lexicon &lexicon, const std::string &text_lower,
+		  std::string *matched = nullptr);
+
+#endif // LEXICON_H
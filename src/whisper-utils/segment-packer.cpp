@@ -0,0 +1,304 @@
+#include "segment-packer.h"
+#include "inference-pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// silence between packed segments, long enough for whisper to end a segment there
+#define PACK_GUARD_SAMPLES (WHISPER_SAMPLE_RATE / 2)
+// stay below whisper's 30 s window, a longer input would be decoded in two passes
+#define PACK_MAX_SAMPLES (28 * WHISPER_SAMPLE_RATE)
+
+namespace {
+
+struct pack_request {
+	const float *pcm;
+	size_t n_samples;
+	uint64_t timestamp_ns;
+	packed_result result;
+	bool done = false;
+};
+
+struct pack_batch {
+	std::vector<pack_request *> requests;
+	// samples of the packed input so far, with the guards
+	size_t n_samples = 0;
+	// time span of a mix
+	uint64_t start_ns = 0;
+	uint64_t end_ns = 0;
+	// no longer accepts segments
+	bool closed = false;
+	std::condition_variable cv;
+};
+
+using batch_key = std::tuple<struct whisper_context *, enum pack_mode, std::string>;
+
+std::mutex packer_mutex;
+// the batches collecting segments, protected by packer_mutex
+std::map<batch_key, std::shared_ptr<pack_batch>> open_batches;
+
+size_t ns_to_samples(uint64_t ns)
+{
+	return (size_t)(ns * WHISPER_SAMPLE_RATE / 1000000000ULL);
+}
+
+uint64_t samples_to_ns(size_t n_samples)
+{
+	return (uint64_t)n_samples * 1000000000ULL / WHISPER_SAMPLE_RATE;
+}
+
+// Everything of the params that changes how a segment is decoded, segments differing in any
+// of it are not packed together
+std::string decode_params_key(const whisper_full_params &params)
+{
+	char numbers[512];
+	snprintf(numbers, sizeof(numbers),
+		 "%d %d %d %d %d %d %d %d %d %d %d %d %d %g %g %g %g %g %g %g %g %g %g",
+		 (int)params.strategy, params.n_threads, params.n_max_text_ctx, params.audio_ctx,
+		 params.greedy.best_of, params.beam_search.beam_size, params.translate,
+		 params.no_context, params.suppress_blank, params.suppress_non_speech_tokens,
+		 params.detect_language, params.speed_up, params.tdrz_enable,
+		 params.beam_search.patience, params.temperature, params.temperature_inc,
+		 params.max_initial_ts, params.length_penalty, params.entropy_thold,
+		 params.logprob_thold, params.no_speech_thold, params.thold_pt,
+		 params.thold_ptsum);
+	std::string key = numbers;
+	key += '\n';
+	key += params.language != nullptr ? params.language : "";
+	key += '\n';
+	key += params.initial_prompt != nullptr ? params.initial_prompt : "";
+	for (int i = 0; params.prompt_tokens != nullptr && i < params.prompt_n_tokens; i++) {
+		key += ' ' + std::to_string(params.prompt_tokens[i]);
+	}
+	return key;
+}
+
+void close_batch(const batch_key &key, const std::shared_ptr<pack_batch> &batch)
+{
+	auto it = open_batches.find(key);
+	if (it != open_batches.end() && it->second == batch) {
+		open_batches.erase(it);
+	}
+	batch->closed = true;
+}
+
+// Add a segment to an open batch if the packed input stays short enough for one pass
+bool join_batch(pack_batch &batch, enum pack_mode mode, pack_request &request)
+{
+	if (mode == PACK_CONCATENATE) {
+		const size_t n_samples = batch.n_samples + PACK_GUARD_SAMPLES + request.n_samples;
+		if (n_samples > PACK_MAX_SAMPLES) {
+			return false;
+		}
+		batch.n_samples = n_samples;
+	} else {
+		const uint64_t start_ns = std::min(batch.start_ns, request.timestamp_ns);
+		const uint64_t end_ns =
+			std::max(batch.end_ns, request.timestamp_ns + samples_to_ns(request.n_samples));
+		if (ns_to_samples(end_ns - start_ns) > PACK_MAX_SAMPLES) {
+			return false;
+		}
+		batch.start_ns = start_ns;
+		batch.end_ns = end_ns;
+		batch.n_samples = ns_to_samples(end_ns - start_ns);
+	}
+	batch.requests.push_back(&request);
+	return true;
+}
+
+// The packed input and the offset of every segment in it
+void pack_input(enum pack_mode mode, const pack_batch &batch,
+		const std::vector<pack_request *> &requests, std::vector<float> &packed,
+		std::vector<size_t> &offsets)
+{
+	packed.reserve(batch.n_samples);
+	for (pack_request *r : requests) {
+		if (mode == PACK_CONCATENATE) {
+			if (!packed.empty()) {
+				packed.resize(packed.size() + PACK_GUARD_SAMPLES, 0.0f);
+			}
+			offsets.push_back(packed.size());
+			packed.insert(packed.end(), r->pcm, r->pcm + r->n_samples);
+		} else {
+			const size_t offset = ns_to_samples(r->timestamp_ns - batch.start_ns);
+			offsets.push_back(offset);
+			if (packed.size() < offset + r->n_samples) {
+				packed.resize(offset + r->n_samples, 0.0f);
+			}
+			for (size_t i = 0; i < r->n_samples; i++) {
+				packed[offset + i] += r->pcm[i];
+			}
+		}
+	}
+}
+
+// Hand every segment the tokens whose midpoint falls into its range, guards included. A mix
+// hands all tokens to every segment.
+void split_results(struct whisper_context *ctx, struct whisper_state *state,
+		   enum pack_mode mode, const std::vector<pack_request *> &requests,
+		   const std::vector<size_t> &offsets)
+{
+	std::vector<int> n_tokens(requests.size(), 0);
+	const whisper_token eot = whisper_token_eot(ctx);
+	const int n_segments = whisper_full_n_segments_from_state(state);
+	for (int i = 0; i < n_segments; i++) {
+		const int n = whisper_full_n_tokens_from_state(state, i);
+		for (int j = 0; j < n; j++) {
+			const whisper_token_data token =
+				whisper_full_get_token_data_from_state(state, i, j);
+			if (token.id >= eot) {
+				// timestamps and other special tokens
+				continue;
+			}
+			// token times are in 10 ms, 160 samples
+			const int64_t mid = (token.t0 + token.t1) / 2 * (WHISPER_SAMPLE_RATE / 100);
+			size_t first = 0;
+			while (mode == PACK_CONCATENATE && first + 1 < requests.size() &&
+			       mid >= (int64_t)(offsets[first + 1] - PACK_GUARD_SAMPLES / 2)) {
+				first++;
+			}
+			const size_t last = mode == PACK_CONCATENATE ? first : requests.size() - 1;
+			const char *text = whisper_full_get_token_text_from_state(ctx, state, i, j);
+			for (size_t r = first; r <= last; r++) {
+				packed_result &result = requests[r]->result;
+				const int64_t offset_10ms =
+					(int64_t)offsets[r] / (WHISPER_SAMPLE_RATE / 100);
+				int64_t t0 = token.t0 - offset_10ms;
+				int64_t t1 = token.t1 - offset_10ms;
+				if (mode == PACK_CONCATENATE) {
+					t0 = std::max<int64_t>(0, t0);
+					t1 = std::max<int64_t>(0, t1);
+				}
+				if (n_tokens[r] == 0) {
+					result.t0 = t0;
+				}
+				result.t1 = t1;
+				result.text += text;
+				result.p += token.p;
+				n_tokens[r]++;
+			}
+		}
+	}
+	for (size_t r = 0; r < requests.size(); r++) {
+		if (n_tokens[r] > 0) {
+			requests[r]->result.p /= (float)n_tokens[r];
+		}
+	}
+}
+
+// Transcribe a segment without packing
+packed_result run_alone(struct whisper_context *ctx, struct whisper_state *state,
+			const whisper_full_params &params, const float *pcm, size_t n_samples)
+{
+	packed_result result;
+	result.status = whisper_full_with_state(ctx, state, params, pcm, (int)n_samples);
+	if (result.status != 0 || whisper_full_n_segments_from_state(state) == 0) {
+		return result;
+	}
+	const int n_segment = 0;
+	result.text = whisper_full_get_segment_text_from_state(state, n_segment);
+	result.t0 = whisper_full_get_segment_t0_from_state(state, n_segment);
+	result.t1 = whisper_full_get_segment_t1_from_state(state, n_segment);
+	const int n_tokens = whisper_full_n_tokens_from_state(state, n_segment);
+	for (int j = 0; j < n_tokens; ++j) {
+		result.p += whisper_full_get_token_p_from_state(state, n_segment, j);
+	}
+	if (n_tokens > 0) {
+		result.p /= (float)n_tokens;
+	}
+	return result;
+}
+
+} // namespace
+
+packed_result segment_packer_run(const std::shared_ptr<struct whisper_context> &ctx,
+				 struct whisper_state *state, std::unique_lock<std::mutex> &state_lock,
+				 whisper_full_params params, enum pack_mode mode, const float *pcm,
+				 size_t n_samples, uint64_t timestamp_ns, uint32_t gather_us)
+{
+	if (gather_us == 0) {
+		return run_alone(ctx.get(), state, params, pcm, n_samples);
+	}
+
+	pack_request request;
+	request.pcm = pcm;
+	request.n_samples = n_samples;
+	request.timestamp_ns = timestamp_ns;
+	const batch_key packing_key(ctx.get(), mode, decode_params_key(params));
+
+	std::unique_lock<std::mutex> lock(packer_mutex);
+	auto it = open_batches.find(packing_key);
+	if (it != open_batches.end() && join_batch(*it->second, mode, request)) {
+		// wait for the leader of the batch
+		std::shared_ptr<pack_batch> batch = it->second;
+		if (batch->n_samples + PACK_GUARD_SAMPLES >= PACK_MAX_SAMPLES) {
+			// full, the leader can start
+			close_batch(packing_key, batch);
+			batch->cv.notify_all();
+		}
+		// the state is not needed, e.g. the model can be released meanwhile
+		state_lock.unlock();
+		inference_pool_wait(
+			[&] { batch->cv.wait(lock, [&request] { return request.done; }); });
+		return request.result;
+	}
+
+	// lead a new batch
+	auto batch = std::make_shared<pack_batch>();
+	batch->requests.push_back(&request);
+	batch->n_samples = n_samples;
+	batch->start_ns = timestamp_ns;
+	batch->end_ns = timestamp_ns + samples_to_ns(n_samples);
+	open_batches[packing_key] = batch;
+	inference_pool_wait([&] {
+		batch->cv.wait_for(lock, std::chrono::microseconds(gather_us),
+				   [&batch] { return batch->closed; });
+	});
+	close_batch(packing_key, batch);
+	const std::vector<pack_request *> requests = batch->requests;
+	lock.unlock();
+
+	std::vector<float> packed;
+	std::vector<size_t> offsets;
+	pack_input(mode, *batch, requests, packed, offsets);
+
+	// several segments per call, each needs its own timestamps and all of its tokens: a token
+	// limit for one segment would end the call in the first segments
+	params.max_tokens = 0;
+	params.duration_ms = 0;
+	params.single_segment = false;
+	params.token_timestamps = true;
+
+	int status = -1;
+	try {
+		status = whisper_full_with_state(ctx.get(), state, params, packed.data(),
+						 (int)packed.size());
+		if (status == 0) {
+			split_results(ctx.get(), state, mode, requests, offsets);
+		}
+	} catch (...) {
+		lock.lock();
+		for (pack_request *r : requests) {
+			r->result.status = -1;
+			r->done = true;
+		}
+		batch->cv.notify_all();
+		throw;
+	}
+
+	lock.lock();
+	for (pack_request *r : requests) {
+		r->result.status = status;
+		r->result.batch_size = (int)requests.size();
+		r->done = true;
+	}
+	batch->cv.notify_all();
+	return request.result;
+}
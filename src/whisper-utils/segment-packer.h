@@ -0,0 +1,60 @@
+#ifndef SEGMENT_PACKER_H
+#define SEGMENT_PACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <whisper.h>
+
+// Whisper encodes 30 s of audio per call however short the input is. The packer puts the
+// segments that filters using the same model submit at about the same time into one call:
+// they are concatenated with silence between them, encoded and decoded once, and every
+// segment gets the tokens whose timestamps fall into its range.
+//
+// The first caller leads the batch: it waits up to the gather time for other segments, runs
+// the call on its own state and hands the results to the others, which wait for it. Only
+// segments with equal decode params, language and prompt included, share a call, since the
+// leader's params decode all of them. Callers on inference pool workers wait in
+// inference_pool_wait, so a batch is not limited by the number of concurrent inferences of
+// the pool.
+//
+// Mixed instead of concatenated, the segments are summed at their timestamps like the sources
+// on a bus, and every segment gets the transcription of the mix: one inference for the whole
+// group of sources however many there are.
+
+enum pack_mode {
+	// one after the other, each segment gets its own tokens
+	PACK_CONCATENATE,
+	// summed at their timestamps, each segment gets all tokens
+	PACK_MIX,
+};
+
+// a segment's part of a packed call
+struct packed_result {
+	// whisper_full's result, the same for all segments of the call
+	int status = -1;
+	std::string text;
+	// mean probability of the segment's tokens
+	float p = 0.0f;
+	// first and last token time relative to the segment, in 10 ms, may be negative for a mix
+	int64_t t0 = 0;
+	int64_t t1 = 0;
+	// segments in the call, including this one
+	int batch_size = 1;
+};
+
+// Transcribe a 16 kHz segment starting at timestamp_ns, packed with the segments other
+// callers submit for the same model, mode and decode params within gather_us. state_lock
+// guards the caller's state: a caller joining another's call does not use its state and
+// unlocks it while it waits. Exceptions of whisper reach the leader, the other callers get a
+// failed status. A gather_us of 0 transcribes the segment alone with the params as they are,
+// the result is then the first segment whisper decoded.
+packed_result segment_packer_run(const std::shared_ptr<struct whisper_context> &ctx,
+				 struct whisper_state *state, std::unique_lock<std::mutex> &state_lock,
+				 whisper_full_params params, enum pack_mode mode, const float *pcm,
+				 size_t n_samples, uint64_t timestamp_ns, uint32_t gather_us);
+
+#endif // SEGMENT_PACKER_H
@@ -0,0 +1,189 @@
+#include "shadow-inference.h"
+#include "inference-thread.h"
+#include "whisper-model.h"
+#include "detection.h"
+#include "model-utils/model-store.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+
+// log the statistics every this many compared segments
+#define SHADOW_SUMMARY_SEGMENTS 100
+
+static bool load_shadow_model(shadow_inference &shadow)
+{
+	if (shadow.state != nullptr && shadow.model_path == shadow.config.model_path) {
+		return true;
+	}
+	shadow_inference_release(shadow);
+
+	const std::string model_file = find_model_file(shadow.config.model_path);
+	if (model_file.empty()) {
+		if (shadow.missing_model_path != shadow.config.model_path) {
+			obs_log(LOG_WARNING, "Shadow model %s is not downloaded, the shadow is idle",
+				shadow.config.model_path.c_str());
+			shadow.missing_model_path = shadow.config.model_path;
+		}
+		return false;
+	}
+	shadow.missing_model_path.clear();
+	shadow.ctx = acquire_whisper_model(model_file);
+	shadow.state = shadow.ctx ? whisper_init_state(shadow.ctx.get()) : nullptr;
+	if (shadow.state == nullptr) {
+		obs_log(LOG_ERROR, "Failed to load shadow model %s", model_file.c_str());
+		shadow.ctx.reset();
+		return false;
+	}
+	shadow.model_path = shadow.config.model_path;
+	obs_log(LOG_INFO, "Loaded shadow model %s", model_file.c_str());
+	return true;
+}
+
+bool shadow_inference_run(shadow_inference &shadow, whisper_full_params params, const float *pcm,
+			  int n_samples, shadow_result &result)
+{
+	if (!load_shadow_model(shadow)) {
+		return false;
+	}
+
+	params.n_threads = shadow.config.n_threads;
+	params.audio_ctx = shadow.config.audio_ctx;
+	if (shadow.config.sampling_strategy >= 0) {
+		params.strategy = (enum whisper_sampling_strategy)shadow.config.sampling_strategy;
+		params.beam_search.beam_size = shadow.config.beam_size;
+		params.greedy.best_of = shadow.config.beam_size;
+		params.temperature = shadow.config.temperature;
+	}
+
+	const uint64_t start_ns = os_gettime_ns();
+	const uint64_t start_cpu_ns = process_cpu_time_ns();
+	if (whisper_full_with_state(shadow.ctx.get(), shadow.state, params, pcm, n_samples) != 0) {
+		return false;
+	}
+	result.wall_ns = os_gettime_ns() - start_ns;
+	result.cpu_ns = process_cpu_time_ns() - start_cpu_ns;
+	result.text = whisper_full_n_segments_from_state(shadow.state) > 0
+			      ? whisper_full_get_segment_text_from_state(shadow.state, 0)
+			      : "";
+	return true;
+}
+
+void shadow_inference_release(shadow_inference &shadow)
+{
+	if (shadow.state != nullptr) {
+		whisper_free_state(shadow.state);
+		shadow.state = nullptr;
+	}
+	shadow.ctx.reset();
+	shadow.model_path.clear();
+}
+
+void shadow_inference_log_summary(shadow_inference &shadow, const char *filter_name)
+{
+	if (shadow.segments > 0) {
+		const double n = (double)shadow.segments;
+		obs_log(LOG_INFO,
+			"[%s] shadow %s: %llu segments, %.1f%% decisions agree, %.1f%% texts agree, "
+			"%llu dropped, latency live %.0f ms shadow %.0f ms, shadow cpu %.3f s per audio s",
+			filter_name, shadow.model_path.c_str(), (unsigned long long)shadow.segments,
+			100.0 * (n - (double)shadow.divergent) / n,
+			100.0 * (n - (double)shadow.text_mismatches) / n,
+			(unsigned long long)shadow.dropped, (double)shadow.live_ns / n / 1e6,
+			(double)shadow.shadow_ns / n / 1e6,
+			shadow.audio_sec > 0.0 ? (double)shadow.shadow_cpu_ns / 1e9 / shadow.audio_sec
+					       : 0.0);
+	}
+	shadow.segments = 0;
+	shadow.divergent = 0;
+	shadow.text_mismatches = 0;
+	shadow.dropped = 0;
+	shadow.audio_sec = 0.0;
+	shadow.live_ns = 0;
+	shadow.shadow_ns = 0;
+	shadow.shadow_cpu_ns = 0;
+}
+
+bool shadow_runner_update(shadow_runner &runner, const shadow_config &settings)
+{
+	{
+		std::lock_guard<std::mutex> lock(runner.mutex);
+		runner.settings = settings;
+	}
+	return runner.enabled.exchange(settings.enabled) && !settings.enabled;
+}
+
+bool shadow_runner_begin(shadow_runner &runner, bool has_segment)
+{
+	if (runner.pending.exchange(true)) {
+		if (has_segment) {
+			runner.dropped++;
+		}
+		return false;
+	}
+	return true;
+}
+
+int shadow_runner_threads(shadow_runner &runner)
+{
+	std::lock_guard<std::mutex> lock(runner.mutex);
+	return runner.settings.n_threads;
+}
+
+void shadow_runner_run(shadow_runner &runner, const shadow_segment *segment,
+		       const whisper_full_params &params,
+		       const std::function<int(const std::string &)> &classify,
+		       const char *filter_name)
+{
+	shadow_config config;
+	{
+		std::lock_guard<std::mutex> lock(runner.mutex);
+		config = runner.settings;
+	}
+	shadow_inference &shadow = runner.shadow;
+	shadow.dropped += runner.dropped.exchange(0);
+	if (config != shadow.config) {
+		// the statistics of the old config end here
+		shadow_inference_log_summary(shadow, filter_name);
+		shadow.config = config;
+	}
+	if (!config.enabled || segment == nullptr) {
+		shadow_inference_log_summary(shadow, filter_name);
+		shadow_inference_release(shadow);
+		return;
+	}
+
+	shadow_result result;
+	if (!shadow_inference_run(shadow, params, segment->pcm.data(), (int)segment->pcm.size(),
+				  result)) {
+		return;
+	}
+
+	const std::string text = normalize_text(result.text.c_str());
+	const int shadow_detection = classify(text);
+	shadow.segments++;
+	shadow.audio_sec += (double)segment->pcm.size() / WHISPER_SAMPLE_RATE;
+	shadow.live_ns += segment->live_ns;
+	shadow.shadow_ns += result.wall_ns;
+	shadow.shadow_cpu_ns += result.cpu_ns;
+	if (text != segment->live_text) {
+		shadow.text_mismatches++;
+	}
+	if (shadow_detection != segment->live_result) {
+		shadow.divergent++;
+		obs_log(LOG_INFO, "[%s] shadow diverged: live %s \"%s\", shadow %s \"%s\"",
+			filter_name, detection_result_name(segment->live_result),
+			segment->live_text.c_str(), detection_result_name(shadow_detection),
+			text.c_str());
+	}
+	if (shadow.segments >= SHADOW_SUMMARY_SEGMENTS) {
+		shadow_inference_log_summary(shadow, filter_name);
+	}
+}
+
+void shadow_runner_release(shadow_runner &runner, const char *filter_name)
+{
+	runner.shadow.dropped += runner.dropped.exchange(0);
+	shadow_inference_log_summary(runner.shadow, filter_name);
+	shadow_inference_release(runner.shadow);
+}
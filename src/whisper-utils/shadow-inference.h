@@ -0,0 +1,124 @@
+#ifndef SHADOW_INFERENCE_H
+#define SHADOW_INFERENCE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <whisper.h>
+
+// A candidate configuration run next to the live one on the same audio, see
+// cleanstream-filter.cpp. It never affects the output, only its statistics are logged.
+struct shadow_config {
+	bool enabled = false;
+	std::string model_path;
+	int n_threads = 1;
+	// encoder context size, 0 uses the full 30 s context
+	int audio_ctx = 0;
+	// decoding, -1 decodes like the live config, otherwise a whisper_sampling_strategy with
+	// the beam size (the best of for greedy sampling) and temperature below
+	int sampling_strategy = -1;
+	int beam_size = 5;
+	float temperature = 0.0f;
+
+	bool operator==(const shadow_config &other) const
+	{
+		return enabled == other.enabled && model_path == other.model_path &&
+		       n_threads == other.n_threads && audio_ctx == other.audio_ctx &&
+		       sampling_strategy == other.sampling_strategy &&
+		       beam_size == other.beam_size && temperature == other.temperature;
+	}
+	bool operator!=(const shadow_config &other) const { return !(*this == other); }
+};
+
+struct shadow_inference {
+	shadow_config config;
+	// the model file loaded into ctx, empty if none
+	std::string model_path;
+	std::shared_ptr<struct whisper_context> ctx;
+	struct whisper_state *state = nullptr;
+	// the model last found missing, logged once
+	std::string missing_model_path;
+
+	/* statistics since the shadow was enabled */
+	uint64_t segments = 0;
+	uint64_t divergent = 0;
+	uint64_t text_mismatches = 0;
+	// segments not compared because the previous one was still running
+	uint64_t dropped = 0;
+	double audio_sec = 0.0;
+	uint64_t live_ns = 0;
+	uint64_t shadow_ns = 0;
+	uint64_t shadow_cpu_ns = 0;
+};
+
+struct shadow_result {
+	std::string text;
+	uint64_t wall_ns = 0;
+	// CPU time of the process during the run, with whisper's compute threads
+	uint64_t cpu_ns = 0;
+};
+
+// A live segment handed to the shadow
+struct shadow_segment {
+	// 16 kHz mono
+	std::vector<float> pcm;
+	int live_result;
+	std::string live_text;
+	uint64_t live_ns;
+};
+
+// The shadow of a filter. At most one shadow job of a filter is queued or running on the
+// inference pool, segments arriving meanwhile are dropped so the shadow never builds up a
+// backlog.
+struct shadow_runner {
+	std::mutex mutex;
+	// the settings, protected by mutex
+	shadow_config settings;
+	std::atomic<bool> enabled{false};
+	std::atomic<bool> pending{false};
+	std::atomic<uint64_t> dropped{0};
+	// only used by the shadow job
+	shadow_inference shadow;
+};
+
+// Apply new settings. Returns true if the shadow was just disabled, a job without a segment
+// then logs its statistics and frees its model.
+bool shadow_runner_update(shadow_runner &runner, const shadow_config &settings);
+
+// Claim the shadow job for a segment, or for releasing the model without one. Returns false
+// if a job is already queued or running, the segment is then counted as dropped.
+bool shadow_runner_begin(shadow_runner &runner, bool has_segment);
+
+// Compute threads the next job runs with
+int shadow_runner_threads(shadow_runner &runner);
+
+// The shadow job: compare the shadow config with the live one on the segment. params are the
+// live parameters, classify applies the filter's detection rules to a normalized
+// transcription. Without a segment, or when the shadow was disabled, it releases the model.
+// The caller clears pending once the job is done.
+void shadow_runner_run(shadow_runner &runner, const shadow_segment *segment,
+		       const whisper_full_params &params,
+		       const std::function<int(const std::string &)> &classify,
+		       const char *filter_name);
+
+// Log the statistics and release the model, after the last job
+void shadow_runner_release(shadow_runner &runner, const char *filter_name);
+
+// Run the shadow config on 16 kHz mono audio, loading its model first if needed.
+// params are the live parameters, the shadow overrides are applied on top.
+// Returns false if the model could not be loaded or inference failed.
+bool shadow_inference_run(shadow_inference &shadow, whisper_full_params params, const float *pcm,
+			  int n_samples, shadow_result &result);
+
+// Free the shadow model state and its reference to the model
+void shadow_inference_release(shadow_inference &shadow);
+
+// Log the statistics collected so far and reset them
+void shadow_inference_log_summary(shadow_inference &shadow, const char *filter_name);
+
+#endif // SHADOW_INFERENCE_H
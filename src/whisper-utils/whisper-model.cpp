@@ -0,0 +1,122 @@
+#include "whisper-model.h"
+#include "plugin-support.h"
+#include "model-utils/model-catalog.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+
+#ifdef _WIN32
+#include <fstream>
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+// whisper pads every input to a window of this length
+#define CALIBRATION_WINDOW_SEC 30
+
+static std::mutex models_mutex;
+static std::map<std::string, std::weak_ptr<struct whisper_context>> models;
+static std::set<std::string> calibrated_models;
+
+static struct whisper_context *load_whisper_model(const std::string &model_path)
+{
+	struct whisper_context_params cparams;
+#ifdef LOCALVOCAL_WITH_CUDA
+	cparams.use_gpu = true;
+#else
+	cparams.use_gpu = false;
+#endif
+
+#ifdef _WIN32
+	// convert model path UTF8 to wstring (wchar_t) for whisper
+	int count = MultiByteToWideChar(CP_UTF8, 0, model_path.c_str(), (int)model_path.length(),
+					NULL, 0);
+	std::wstring model_path_ws(count, 0);
+	MultiByteToWideChar(CP_UTF8, 0, model_path.c_str(), (int)model_path.length(),
+			    &model_path_ws[0], count);
+
+	// Read model into buffer
+	std::ifstream modelFile(model_path_ws, std::ios::binary);
+	if (!modelFile.is_open()) {
+		obs_log(LOG_ERROR, "Failed to open whisper model file %s", model_path.c_str());
+		return nullptr;
+	}
+	modelFile.seekg(0, std::ios::end);
+	const size_t modelFileSize = modelFile.tellg();
+	modelFile.seekg(0, std::ios::beg);
+	std::vector<char> modelBuffer(modelFileSize);
+	modelFile.read(modelBuffer.data(), modelFileSize);
+	modelFile.close();
+
+	// Initialize whisper
+	struct whisper_context *ctx = whisper_init_from_buffer_with_params_no_state(
+		modelBuffer.data(), modelFileSize, cparams);
+#else
+	struct whisper_context *ctx =
+		whisper_init_from_file_with_params_no_state(model_path.c_str(), cparams);
+#endif
+	if (ctx == nullptr) {
+		obs_log(LOG_ERROR, "Failed to load whisper model %s", model_path.c_str());
+	}
+	return ctx;
+}
+
+std::shared_ptr<struct whisper_context> acquire_whisper_model(const std::string &model_file)
+{
+	std::error_code ec;
+	std::string key = std::filesystem::weakly_canonical(std::filesystem::u8path(model_file), ec)
+				  .u8string();
+	if (ec) {
+		key = model_file;
+	}
+
+	std::lock_guard<std::mutex> lock(models_mutex);
+	auto it = models.find(key);
+	if (it != models.end()) {
+		std::shared_ptr<struct whisper_context> model = it->second.lock();
+		if (model) {
+			return model;
+		}
+		models.erase(it);
+	}
+
+	struct whisper_context *ctx = load_whisper_model(model_file);
+	if (ctx == nullptr) {
+		return nullptr;
+	}
+	std::shared_ptr<struct whisper_context> model(ctx, [](struct whisper_context *c) {
+		whisper_free(c);
+	});
+	models[key] = model;
+	return model;
+}
+
+void calibrate_whisper_model(const std::string &model_name, struct whisper_context *ctx,
+			     struct whisper_state *state, int n_threads)
+{
+	{
+		std::lock_guard<std::mutex> lock(models_mutex);
+		if (!calibrated_models.insert(model_name).second) {
+			return;
+		}
+	}
+
+	const std::vector<float> window(CALIBRATION_WINDOW_SEC * WHISPER_SAMPLE_RATE, 0.0f);
+	const uint64_t start_ns = os_gettime_ns();
+	if (whisper_pcm_to_mel_with_state(ctx, state, window.data(), (int)window.size(),
+					  n_threads) != 0 ||
+	    whisper_encode_with_state(ctx, state, 0, n_threads) != 0) {
+		obs_log(LOG_WARNING, "Calibration of model %s failed", model_name.c_str());
+		return;
+	}
+	const double rtf = (double)(os_gettime_ns() - start_ns) / 1e9 / CALIBRATION_WINDOW_SEC;
+	obs_log(LOG_INFO, "Model %s encodes a %d s window at %.3fx real time, %d threads",
+		model_name.c_str(), CALIBRATION_WINDOW_SEC, rtf, n_threads);
+	model_catalog_record_rtf(model_name, rtf);
+}
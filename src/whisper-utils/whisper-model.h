@@ -0,0 +1,19 @@
+#ifndef WHISPER_MODEL_H
+#define WHISPER_MODEL_H
+
+#include <memory>
+#include <string>
+
+#include <whisper.h>
+
+// Models loaded in this process, shared by all filters using the same model file.
+// Every filter runs inference on its own whisper_state, so the weights of a model are loaded
+// once no matter how many filters use it. The model is freed with the last reference.
+std::shared_ptr<struct whisper_context> acquire_whisper_model(const std::string &model_file);
+
+// Time the encoder on a full 30 s window, the input size whisper encodes for every segment,
+// once per model name and process. The real time factor goes to the model catalog.
+void calibrate_whisper_model(const std::string &model_name, struct whisper_context *ctx,
+			     struct whisper_state *state, int n_threads);
+
+#endif // WHISPER_MODEL_H